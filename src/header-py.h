@@ -21,6 +21,13 @@ extern PyObject * pyrpmError;
 
 #define hdrObject_Check(v)	((v)->ob_type == &hdr_Type)
 
+/** \ingroup py_c
+ * headerFormat() query for name-[epoch:]version-release.arch, spelled out
+ * as rpm has no %{nevra} tag extension for it.
+ */
+#define	HEADER_NEVRA_FMT \
+    "%{name}-%|epoch?{%{epoch}:}:{}|%{version}-%{release}.%{arch}"
+
 PyObject * hdr_Wrap(Header h);
 
 Header hdrGetHeader(hdrObject * h);
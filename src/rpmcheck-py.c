@@ -0,0 +1,655 @@
+/** \ingroup py_c
+ * \file python/rpmcheck-py.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpm/rpmlib.h>		/* rpmCheckRpmlibProvides */
+#include <rpm/rpmdb.h>
+#include <rpm/rpmfi.h>
+#include <rpm/rpmte.h>
+#include <rpm/rpmstring.h>
+
+#include "rpmcheck-py.h"
+
+void instancesAdd(struct instances_s * insts, unsigned int offset)
+{
+    int i;
+
+    /* match sets are small, a linear duplicate check is fine */
+    for (i = 0; i < insts->n; i++) {
+	if (insts->offsets[i] == offset)
+	    return;
+    }
+    if (insts->n == insts->nalloced) {
+	insts->nalloced = insts->nalloced ? 2 * insts->nalloced : 8;
+	insts->offsets = xrealloc(insts->offsets,
+				  insts->nalloced * sizeof(*insts->offsets));
+    }
+    insts->offsets[insts->n++] = offset;
+}
+
+void dbWhatProvides(rpmtsObject * s, rpmds dep, struct instances_s * insts)
+{
+    const char * N = rpmdsN(dep);
+    rpmdbMatchIterator mi;
+    Header h;
+
+    if (*N == '/') {
+	mi = rpmtsDbIterator(s, RPMTAG_BASENAMES, N, 0);
+	while ((h = rpmdbNextIterator(mi)) != NULL)
+	    instancesAdd(insts, rpmdbGetIteratorOffset(mi));
+	mi = rpmdbFreeIterator(mi);
+    }
+
+    mi = rpmtsDbIterator(s, RPMTAG_PROVIDENAME, N, 0);
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	if (rpmdsAnyMatchesDep(h, dep, _rpmds_nopromote))
+	    instancesAdd(insts, rpmdbGetIteratorOffset(mi));
+    }
+    mi = rpmdbFreeIterator(mi);
+}
+
+void dbWhatRequires(rpmtsObject * s, rpmds dep, struct instances_s * insts)
+{
+    const char * N = rpmdsN(dep);
+    rpmdbMatchIterator mi;
+    Header h;
+
+    mi = rpmtsDbIterator(s, RPMTAG_REQUIRENAME, N, 0);
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	rpmds req = rpmdsNew(h, RPMTAG_REQUIRENAME, 0);
+
+	req = rpmdsInit(req);
+	while (rpmdsNext(req) >= 0) {
+	    if (strcmp(rpmdsN(req), N))
+		continue;
+	    if (rpmdsCompare(req, dep)) {
+		instancesAdd(insts, rpmdbGetIteratorOffset(mi));
+		break;
+	    }
+	}
+	req = rpmdsFree(req);
+    }
+    mi = rpmdbFreeIterator(mi);
+}
+
+/* ---------- */
+
+/**
+ * Chained hash of dependency (or file base) names of added elements.
+ * Names point into the element ds/fi data, which lives as long as the
+ * element does.
+ */
+struct nameEntry_s {
+    const char * name;
+    unsigned int hash;
+    rpmte te;
+    int ix;			/*!< ds or fi index */
+    int next;
+};
+
+struct nameIndex_s {
+    int * buckets;
+    int nbuckets;
+    struct nameEntry_s * entries;
+    int nentries;
+    int nalloced;
+};
+
+static unsigned int nameHash(const char * s)
+{
+    unsigned int h = 2166136261U;
+
+    while (*s != '\0') {
+	h ^= (unsigned char) *s++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+static void nameIndexAdd(struct nameIndex_s * ni, const char * name,
+		rpmte te, int ix)
+{
+    struct nameEntry_s * e;
+    int i;
+
+    if (ni->nentries >= 2 * ni->nbuckets) {
+	ni->nbuckets = ni->nbuckets ? 4 * ni->nbuckets : 1024;
+	free(ni->buckets);
+	ni->buckets = xmalloc(ni->nbuckets * sizeof(*ni->buckets));
+	for (i = 0; i < ni->nbuckets; i++)
+	    ni->buckets[i] = -1;
+	for (i = 0; i < ni->nentries; i++) {
+	    int b = ni->entries[i].hash % ni->nbuckets;
+	    ni->entries[i].next = ni->buckets[b];
+	    ni->buckets[b] = i;
+	}
+    }
+    if (ni->nentries == ni->nalloced) {
+	ni->nalloced = ni->nalloced ? 2 * ni->nalloced : 1024;
+	ni->entries = xrealloc(ni->entries,
+			       ni->nalloced * sizeof(*ni->entries));
+    }
+
+    e = &ni->entries[ni->nentries];
+    e->name = name;
+    e->hash = nameHash(name);
+    e->te = te;
+    e->ix = ix;
+    e->next = ni->buckets[e->hash % ni->nbuckets];
+    ni->buckets[e->hash % ni->nbuckets] = ni->nentries++;
+}
+
+/**
+ * Return the next entry (after entry i, -1 to start) matching a name.
+ */
+static int nameIndexNext(const struct nameIndex_s * ni, const char * name,
+		unsigned int hash, int i)
+{
+    if (ni->nbuckets == 0)
+	return -1;
+    i = (i < 0) ? ni->buckets[hash % ni->nbuckets] : ni->entries[i].next;
+    for (; i >= 0; i = ni->entries[i].next) {
+	if (ni->entries[i].hash == hash && !strcmp(ni->entries[i].name, name))
+	    break;
+    }
+    return i;
+}
+
+static void nameIndexFree(struct nameIndex_s * ni)
+{
+    free(ni->buckets);
+    free(ni->entries);
+    memset(ni, 0, sizeof(*ni));
+}
+
+/**
+ * A problem found by the checker, owned either by an element or by an
+ * installed package.
+ */
+struct checkProb_s {
+    rpmProblemType type;
+    rpmte te;			/*!< owning element (or NULL) */
+    unsigned int dbinst;	/*!< owning installed package (or 0) */
+    char * pkgNEVR;
+    rpmds dep;			/*!< single copy of the dependency */
+};
+
+/**
+ * Dependency sets whose names the checker indexes. Links to them are
+ * held as long as the element is known, so that their addresses can't
+ * be recycled for another element (or the same one after rpmtsClean()).
+ */
+static const rpmTag checkTags[] = {
+    RPMTAG_PROVIDENAME, RPMTAG_REQUIRENAME, RPMTAG_CONFLICTNAME
+};
+#define	NCHECKTAGS	(sizeof(checkTags) / sizeof(checkTags[0]))
+
+/**
+ * A checked element, at its position in the transaction set.
+ */
+struct checkElem_s {
+    rpmte te;
+    rpmds ds[NCHECKTAGS];	/*!< linked dependency sets of te */
+};
+
+struct rpmcheck_s {
+    struct checkElem_s * elems;	/*!< checked elements, in insertion order */
+    int nelems;
+    rpmte * added;		/*!< added elements, in order */
+    int nadded;
+    int nfiled;			/*!< added elements with files indexed */
+    struct nameIndex_s provides;
+    struct nameIndex_s requires;
+    struct nameIndex_s conflicts;
+    struct nameIndex_s files;	/*!< base names of added elements */
+    unsigned int * erased;	/*!< instances of removed elements, sorted */
+    int nerased;
+    struct checkProb_s * probs;
+    int nprobs;
+    int nalloced;
+};
+
+static int uintCmp(const void * a, const void * b)
+{
+    unsigned int A = *(const unsigned int *) a;
+    unsigned int B = *(const unsigned int *) b;
+    return (A > B) - (A < B);
+}
+
+static int isErased(rpmcheck chk, unsigned int inst)
+{
+    return bsearch(&inst, chk->erased, chk->nerased, sizeof(*chk->erased),
+		   uintCmp) != NULL;
+}
+
+static void indexDS(struct nameIndex_s * ni, rpmte te, rpmTag tag)
+{
+    rpmds ds = rpmteDS(te, tag);
+
+    ds = rpmdsInit(ds);
+    while (rpmdsNext(ds) >= 0)
+	nameIndexAdd(ni, rpmdsN(ds), te, rpmdsIx(ds));
+}
+
+/**
+ * Index file base names of added elements, only done once file
+ * dependencies are actually looked up.
+ */
+static void indexFiles(rpmcheck chk)
+{
+    for (; chk->nfiled < chk->nadded; chk->nfiled++) {
+	rpmte te = chk->added[chk->nfiled];
+	rpmfi fi = rpmfiInit(rpmteFI(te), 0);
+
+	while (rpmfiNext(fi) >= 0)
+	    nameIndexAdd(&chk->files, rpmfiBN(fi), te, rpmfiFX(fi));
+    }
+}
+
+/**
+ * Is a dependency provided by an added element?
+ * @param chk		checker
+ * @param dep		dependency (current entry)
+ * @param exclude	element not to consider (or NULL)
+ */
+static int addedProvides(rpmcheck chk, rpmds dep, rpmte exclude)
+{
+    const char * N = rpmdsN(dep);
+    unsigned int hash = nameHash(N);
+    int i;
+
+    for (i = nameIndexNext(&chk->provides, N, hash, -1); i >= 0;
+	 i = nameIndexNext(&chk->provides, N, hash, i)) {
+	struct nameEntry_s * e = &chk->provides.entries[i];
+	rpmds p;
+	int ix, match;
+
+	if (e->te == exclude)
+	    continue;
+	p = rpmteDS(e->te, RPMTAG_PROVIDENAME);
+	ix = rpmdsIx(p);
+	(void) rpmdsSetIx(p, e->ix);
+	match = rpmdsCompare(p, dep);
+	(void) rpmdsSetIx(p, ix);
+	if (match)
+	    return 1;
+    }
+
+    if (*N == '/') {
+	const char * bn = strrchr(N, '/') + 1;
+	size_t dnlen = bn - N;
+
+	indexFiles(chk);
+	hash = nameHash(bn);
+	for (i = nameIndexNext(&chk->files, bn, hash, -1); i >= 0;
+	     i = nameIndexNext(&chk->files, bn, hash, i)) {
+	    struct nameEntry_s * e = &chk->files.entries[i];
+	    rpmfi fi;
+	    const char * dn;
+
+	    if (e->te == exclude)
+		continue;
+	    fi = rpmteFI(e->te);
+	    (void) rpmfiSetFX(fi, e->ix);
+	    dn = rpmfiDN(fi);
+	    if (strlen(dn) == dnlen && !strncmp(dn, N, dnlen))
+		return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+ * Is a dependency provided by an installed package that stays installed?
+ */
+static int dbProvides(rpmcheck chk, rpmtsObject * s, rpmds dep)
+{
+    struct instances_s insts = { 0, 0, NULL };
+    int found = 0;
+    int i;
+
+    dbWhatProvides(s, dep, &insts);
+    for (i = 0; i < insts.n && !found; i++)
+	found = !isErased(chk, insts.offsets[i]);
+    free(insts.offsets);
+    return found;
+}
+
+static int satisfied(rpmcheck chk, rpmtsObject * s, rpmds dep)
+{
+    if (!strncmp(rpmdsN(dep), "rpmlib(", sizeof("rpmlib(")-1))
+	return rpmCheckRpmlibProvides(dep);
+    return addedProvides(chk, dep, NULL) || dbProvides(chk, s, dep);
+}
+
+static int conflicting(rpmcheck chk, rpmtsObject * s, rpmds dep, rpmte self)
+{
+    return addedProvides(chk, dep, self) || dbProvides(chk, s, dep);
+}
+
+static void probAdd(rpmcheck chk, rpmProblemType type, rpmte te,
+		unsigned int dbinst, const char * pkgNEVR, rpmds dep)
+{
+    struct checkProb_s * p;
+    const char * DNEVR = rpmdsDNEVR(dep);
+    int i;
+
+    for (i = 0; i < chk->nprobs; i++) {
+	p = &chk->probs[i];
+	if (p->type == type && p->te == te && p->dbinst == dbinst
+	 && !strcmp(rpmdsDNEVR(p->dep), DNEVR))
+	    return;
+    }
+
+    if (chk->nprobs == chk->nalloced) {
+	chk->nalloced = chk->nalloced ? 2 * chk->nalloced : 16;
+	chk->probs = xrealloc(chk->probs, chk->nalloced * sizeof(*chk->probs));
+    }
+    p = &chk->probs[chk->nprobs++];
+    p->type = type;
+    p->te = te;
+    p->dbinst = dbinst;
+    p->pkgNEVR = xstrdup(pkgNEVR);
+    p->dep = rpmdsSingle(rpmdsTagN(dep), rpmdsN(dep), rpmdsEVR(dep),
+			 rpmdsFlags(dep));
+    (void) rpmdsNext(rpmdsInit(p->dep));
+}
+
+static void probFree(struct checkProb_s * p)
+{
+    free(p->pkgNEVR);
+    p->dep = rpmdsFree(p->dep);
+}
+
+/**
+ * Re-evaluate problems found earlier against the current elements.
+ */
+static void recheckProbs(rpmcheck chk, rpmtsObject * s)
+{
+    int i, n = 0;
+
+    for (i = 0; i < chk->nprobs; i++) {
+	struct checkProb_s * p = &chk->probs[i];
+	int keep;
+
+	if (p->dbinst && isErased(chk, p->dbinst))
+	    keep = 0;
+	else if (p->type == RPMPROB_REQUIRES)
+	    keep = !satisfied(chk, s, p->dep);
+	else if (p->te != NULL)
+	    keep = conflicting(chk, s, p->dep, p->te);
+	else
+	    keep = addedProvides(chk, p->dep, NULL);
+
+	if (keep)
+	    chk->probs[n++] = *p;
+	else
+	    probFree(p);
+    }
+    chk->nprobs = n;
+}
+
+/**
+ * Check requires and conflicts of an added element, and conflicts of
+ * installed packages against it.
+ */
+static void checkAdded(rpmcheck chk, rpmtsObject * s, rpmte te)
+{
+    const char * N = rpmteN(te);
+    rpmdbMatchIterator mi;
+    Header h;
+    rpmds ds;
+
+    ds = rpmdsInit(rpmteDS(te, RPMTAG_REQUIRENAME));
+    while (rpmdsNext(ds) >= 0) {
+	if (!satisfied(chk, s, ds))
+	    probAdd(chk, RPMPROB_REQUIRES, te, 0, rpmteNEVRA(te), ds);
+    }
+
+    ds = rpmdsInit(rpmteDS(te, RPMTAG_CONFLICTNAME));
+    while (rpmdsNext(ds) >= 0) {
+	if (conflicting(chk, s, ds, te))
+	    probAdd(chk, RPMPROB_CONFLICT, te, 0, rpmteNEVRA(te), ds);
+    }
+
+    /* Installed packages conflicting with the element's name. */
+    mi = rpmtsDbIterator(s, RPMTAG_CONFLICTNAME, N, 0);
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	unsigned int inst = rpmdbGetIteratorOffset(mi);
+	char * nevra;
+
+	if (isErased(chk, inst))
+	    continue;
+	/* same pkgNEVR as rpmtsCheck() reports for installed packages */
+	nevra = headerGetNEVRA(h, NULL);
+	ds = rpmdsInit(rpmdsNew(h, RPMTAG_CONFLICTNAME, 0));
+	while (rpmdsNext(ds) >= 0) {
+	    if (!strcmp(rpmdsN(ds), N) && addedProvides(chk, ds, NULL))
+		probAdd(chk, RPMPROB_CONFLICT, NULL, inst, nevra, ds);
+	}
+	ds = rpmdsFree(ds);
+	free(nevra);
+    }
+    mi = rpmdbFreeIterator(mi);
+
+    /* Conflicts of other added elements against the element's provides. */
+    ds = rpmdsInit(rpmteDS(te, RPMTAG_PROVIDENAME));
+    while (rpmdsNext(ds) >= 0) {
+	const char * PN = rpmdsN(ds);
+	unsigned int hash = nameHash(PN);
+	int i;
+
+	for (i = nameIndexNext(&chk->conflicts, PN, hash, -1); i >= 0;
+	     i = nameIndexNext(&chk->conflicts, PN, hash, i)) {
+	    struct nameEntry_s * e = &chk->conflicts.entries[i];
+	    rpmds c;
+	    int ix;
+
+	    if (e->te == te)
+		continue;
+	    c = rpmteDS(e->te, RPMTAG_CONFLICTNAME);
+	    ix = rpmdsIx(c);
+	    (void) rpmdsSetIx(c, e->ix);
+	    if (conflicting(chk, s, c, e->te))
+		probAdd(chk, RPMPROB_CONFLICT, e->te, 0, rpmteNEVRA(e->te), c);
+	    (void) rpmdsSetIx(c, ix);
+	}
+    }
+}
+
+/**
+ * Check requires of installed and added packages on a name (or path)
+ * that a removed element provided.
+ */
+static void checkRemovedName(rpmcheck chk, rpmtsObject * s, const char * N)
+{
+    unsigned int hash = nameHash(N);
+    rpmdbMatchIterator mi;
+    Header h;
+    rpmds ds;
+    int i;
+
+    mi = rpmtsDbIterator(s, RPMTAG_REQUIRENAME, N, 0);
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	unsigned int inst = rpmdbGetIteratorOffset(mi);
+	char * nevra = NULL;
+
+	if (isErased(chk, inst))
+	    continue;
+	ds = rpmdsInit(rpmdsNew(h, RPMTAG_REQUIRENAME, 0));
+	while (rpmdsNext(ds) >= 0) {
+	    if (strcmp(rpmdsN(ds), N) || satisfied(chk, s, ds))
+		continue;
+	    if (nevra == NULL)
+		nevra = headerGetNEVRA(h, NULL);
+	    probAdd(chk, RPMPROB_REQUIRES, NULL, inst, nevra, ds);
+	}
+	ds = rpmdsFree(ds);
+	free(nevra);
+    }
+    mi = rpmdbFreeIterator(mi);
+
+    for (i = nameIndexNext(&chk->requires, N, hash, -1); i >= 0;
+	 i = nameIndexNext(&chk->requires, N, hash, i)) {
+	struct nameEntry_s * e = &chk->requires.entries[i];
+	int ix;
+
+	ds = rpmteDS(e->te, RPMTAG_REQUIRENAME);
+	ix = rpmdsIx(ds);
+	(void) rpmdsSetIx(ds, e->ix);
+	if (!satisfied(chk, s, ds))
+	    probAdd(chk, RPMPROB_REQUIRES, e->te, 0, rpmteNEVRA(e->te), ds);
+	(void) rpmdsSetIx(ds, ix);
+    }
+}
+
+static void checkRemoved(rpmcheck chk, rpmtsObject * s, rpmte te)
+{
+    rpmds ds;
+    rpmfi fi;
+
+    checkRemovedName(chk, s, rpmteN(te));
+
+    ds = rpmdsInit(rpmteDS(te, RPMTAG_PROVIDENAME));
+    while (rpmdsNext(ds) >= 0)
+	checkRemovedName(chk, s, rpmdsN(ds));
+
+    fi = rpmfiInit(rpmteFI(te), 0);
+    while (rpmfiNext(fi) >= 0)
+	checkRemovedName(chk, s, rpmfiFN(fi));
+}
+
+rpmcheck rpmcheckFree(rpmcheck chk)
+{
+    int i;
+
+    if (chk == NULL)
+	return NULL;
+    for (i = 0; i < chk->nprobs; i++)
+	probFree(&chk->probs[i]);
+    nameIndexFree(&chk->provides);
+    nameIndexFree(&chk->requires);
+    nameIndexFree(&chk->conflicts);
+    nameIndexFree(&chk->files);
+    for (i = 0; i < chk->nelems; i++) {
+	int j;
+	for (j = 0; j < NCHECKTAGS; j++)
+	    chk->elems[i].ds[j] = rpmdsFree(chk->elems[i].ds[j]);
+    }
+    free(chk->probs);
+    free(chk->elems);
+    free(chk->added);
+    free(chk->erased);
+    free(chk);
+    return NULL;
+}
+
+/**
+ * Is the element at a position the one checked before?
+ */
+static int sameElement(const struct checkElem_s * elem, rpmte te)
+{
+    int j;
+
+    if (elem->te != te)
+	return 0;
+    for (j = 0; j < NCHECKTAGS; j++) {
+	if (rpmteDS(te, checkTags[j]) != elem->ds[j])
+	    return 0;
+    }
+    return 1;
+}
+
+rpmps rpmcheckRun(rpmcheck * chkp, rpmtsObject * s, rpmds * unresolved)
+{
+    rpmcheck chk = *chkp;
+    int nelements = rpmtsNElements(s->ts);
+    rpmte * fresh = xcalloc(nelements + 1, sizeof(*fresh));
+    int nfresh = 0;
+    rpmps ps = NULL;
+    int i, j;
+
+    /*
+     * Elements are known by position, elements are only ever appended.
+     * Anything else (removed, replaced or reordered elements, cleaned
+     * dependency sets) invalidates everything.
+     */
+    if (chk != NULL) {
+	if (chk->nelems > nelements)
+	    chk = rpmcheckFree(chk);
+	for (i = 0; chk != NULL && i < chk->nelems; i++) {
+	    if (!sameElement(&chk->elems[i], rpmtsElement(s->ts, i)))
+		chk = rpmcheckFree(chk);
+	}
+    }
+    if (chk == NULL)
+	chk = xcalloc(1, sizeof(*chk));
+
+    /* Index the new elements before checking anything. */
+    chk->elems = xrealloc(chk->elems, (nelements + 1) * sizeof(*chk->elems));
+    chk->added = xrealloc(chk->added, (nelements + 1) * sizeof(*chk->added));
+    chk->erased = xrealloc(chk->erased, (nelements + 1) * sizeof(*chk->erased));
+    chk->nerased = 0;
+    for (i = 0; i < nelements; i++) {
+	rpmte te = rpmtsElement(s->ts, i);
+
+	if (rpmteType(te) == TR_REMOVED)
+	    chk->erased[chk->nerased++] = rpmteDBOffset(te);
+
+	if (i < chk->nelems)
+	    continue;
+	chk->elems[i].te = te;
+	for (j = 0; j < NCHECKTAGS; j++)
+	    chk->elems[i].ds[j] = rpmdsLink(rpmteDS(te, checkTags[j]),
+					    "rpmcheck");
+	fresh[nfresh++] = te;
+	if (rpmteType(te) == TR_ADDED) {
+	    chk->added[chk->nadded++] = te;
+	    indexDS(&chk->provides, te, RPMTAG_PROVIDENAME);
+	    indexDS(&chk->requires, te, RPMTAG_REQUIRENAME);
+	    indexDS(&chk->conflicts, te, RPMTAG_CONFLICTNAME);
+	}
+    }
+    chk->nelems = nelements;
+    qsort(chk->erased, chk->nerased, sizeof(*chk->erased), uintCmp);
+
+    recheckProbs(chk, s);
+
+    for (i = 0; i < nfresh; i++) {
+	if (rpmteType(fresh[i]) == TR_ADDED)
+	    checkAdded(chk, s, fresh[i]);
+	else
+	    checkRemoved(chk, s, fresh[i]);
+    }
+
+    free(fresh);
+
+    if (chk->nprobs > 0) {
+	ps = rpmpsCreate();
+	for (i = 0; i < chk->nprobs; i++) {
+	    struct checkProb_s * p = &chk->probs[i];
+	    rpmpsAppend(ps, p->type, p->pkgNEVR,
+			p->te ? rpmteKey(p->te) : NULL, NULL, NULL,
+			rpmdsDNEVR(p->dep), 0);
+	    if (unresolved && p->type == RPMPROB_REQUIRES) {
+		(void) rpmdsMerge(unresolved, p->dep);
+		(void) rpmdsNext(rpmdsInit(p->dep));
+	    }
+	}
+    }
+
+    *chkp = chk;
+    return ps;
+}
+
+rpmds rpmcheckProblem(rpmcheck chk, int i, rpmte * tep, unsigned int * instp)
+{
+    if (chk == NULL || i < 0 || i >= chk->nprobs)
+	return NULL;
+    *tep = chk->probs[i].te;
+    *instp = chk->probs[i].dbinst;
+    return chk->probs[i].dep;
+}
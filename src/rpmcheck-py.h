@@ -0,0 +1,76 @@
+#ifndef H_RPMCHECK_PY
+#define H_RPMCHECK_PY
+
+#include <rpm/rpmds.h>
+#include <rpm/rpmps.h>
+
+#include "rpmts-py.h"
+
+/** \ingroup py_c
+ * \file python/rpmcheck-py.h
+ */
+
+/**
+ * Installed package instances, as returned by rpmdb dependency lookups.
+ */
+struct instances_s {
+    int n;
+    int nalloced;
+    unsigned int * offsets;
+};
+
+/**
+ * Add an instance (once) to a set of instances.
+ */
+void instancesAdd(struct instances_s * insts, unsigned int offset);
+
+/**
+ * Find installed packages providing a dependency, file provides included.
+ * @param s		transaction set
+ * @param dep		dependency (current entry)
+ * @retval insts	matching instances
+ */
+void dbWhatProvides(rpmtsObject * s, rpmds dep, struct instances_s * insts);
+
+/**
+ * Find installed packages with a requirement satisfied by a provide.
+ * @param s		transaction set
+ * @param dep		provided dependency (current entry)
+ * @retval insts	matching instances
+ */
+void dbWhatRequires(rpmtsObject * s, rpmds dep, struct instances_s * insts);
+
+/**
+ * Incremental dependency checker state of a transaction set.
+ */
+typedef struct rpmcheck_s * rpmcheck;
+
+/**
+ * Check dependencies of a transaction set, only evaluating what is
+ * affected by elements added since the previous check with the same
+ * state. Problems found earlier are re-evaluated and kept or dropped.
+ * rpmdb lookups go through rpmtsDbIterator().
+ * @param chkp		checker state (created on first use)
+ * @param s		transaction set
+ * @retval unresolved	unresolved requires are merged here (or NULL)
+ * @return		problems, NULL if there are none
+ */
+rpmps rpmcheckRun(rpmcheck * chkp, rpmtsObject * s, rpmds * unresolved);
+
+/**
+ * Return what a problem of the last rpmcheckRun() set was built from.
+ * @param chk		checker state
+ * @param i		problem index
+ * @retval *tep		owning element (or NULL)
+ * @retval *instp	owning installed package (or 0)
+ * @return		dependency (not linked), NULL if out of range
+ */
+rpmds rpmcheckProblem(rpmcheck chk, int i, rpmte * tep, unsigned int * instp);
+
+/**
+ * Free checker state.
+ * @return		NULL always
+ */
+rpmcheck rpmcheckFree(rpmcheck chk);
+
+#endif
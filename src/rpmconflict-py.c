@@ -0,0 +1,510 @@
+/** \ingroup py_c
+ * \file python/rpmconflict-py.c
+ */
+
+#include <rpm/rpmdb.h>
+#include <rpm/rpmfi.h>
+#include <rpm/rpmstring.h>
+#include <rpm/fprint.h>
+
+#include "header-py.h"
+#include "rpmts-py.h"
+#include "rpmconflict-py.h"
+#include "strpool-py.h"
+#include "rpmdebug-py.h"
+
+/**
+ * A package taking part in conflict detection, candidate or installed.
+ */
+struct conflictPkg_s {
+    rpmfi fi;
+    char * nevra;
+    int pkg;			/*!< index in headers, -1 if installed */
+    unsigned int instance;	/*!< rpmdb instance, 0 if candidate */
+};
+
+/**
+ * A file of a package, identified by interned basename and fingerprint,
+ * so that paths through symlinked directories are the same path.
+ */
+struct conflictFile_s {
+    unsigned int bn;
+    fingerPrint fp;
+    int owner;			/*!< index in conflictPkg_s array */
+    int fx;
+};
+
+/**
+ */
+struct conflictSet_s {
+    strpool pool;		/*!< basenames of candidate files */
+    fingerPrintCache fpc;
+    char * root;		/*!< root directory of the fingerprints (or NULL) */
+    char ** dirs;		/*!< rooted dirnames fingerprints point into */
+    int ndirs;
+    struct conflictPkg_s * pkgs;
+    int npkgs;
+    int ncandidates;		/*!< candidates come first in pkgs */
+    struct conflictFile_s * files;
+    int nfiles;
+    int nalloced;
+    int * pairs;		/*!< conflicting file pairs (file indices) */
+    int npairs;
+    int npalloced;
+};
+
+static void conflictAddFile(struct conflictSet_s * cs, unsigned int bn,
+		fingerPrint fp, int owner, int fx)
+{
+    struct conflictFile_s * f;
+
+    if (cs->nfiles == cs->nalloced) {
+	cs->nalloced = cs->nalloced ? 2 * cs->nalloced : 4096;
+	cs->files = xrealloc(cs->files, cs->nalloced * sizeof(*cs->files));
+    }
+    f = cs->files + cs->nfiles++;
+    f->bn = bn;
+    f->fp = fp;
+    f->owner = owner;
+    f->fx = fx;
+}
+
+/**
+ * Fingerprint the current file of a package, looking each directory up
+ * only once.
+ * @param dirfps	directory fingerprints of the package, by dir index
+ */
+static fingerPrint conflictFingerprint(struct conflictSet_s * cs, rpmfi fi,
+		fingerPrint * dirfps)
+{
+    int dx = rpmfiDX(fi);
+    fingerPrint fp;
+
+    if (dirfps[dx].entry == NULL) {
+	const char * dn = rpmfiDN(fi);
+	if (cs->root) {
+	    cs->dirs = xrealloc(cs->dirs, (cs->ndirs + 1) * sizeof(*cs->dirs));
+	    dn = cs->dirs[cs->ndirs++] = rstrscat(NULL, cs->root, dn, NULL);
+	}
+	dirfps[dx] = fpLookup(cs->fpc, dn, rpmfiBN(fi), 1);
+    }
+    fp = dirfps[dx];
+    fp.baseName = rpmfiBN(fi);
+    return fp;
+}
+
+/**
+ * Add a package, taking over its file info.
+ */
+static int conflictAddPkg(struct conflictSet_s * cs, Header h, rpmfi fi,
+		int pkg, unsigned int instance)
+{
+    struct conflictPkg_s * p;
+
+    cs->pkgs = xrealloc(cs->pkgs, (cs->npkgs + 1) * sizeof(*cs->pkgs));
+    p = cs->pkgs + cs->npkgs;
+    p->fi = fi;
+    p->nevra = headerFormat(h, HEADER_NEVRA_FMT, NULL);
+    p->pkg = pkg;
+    p->instance = instance;
+    return cs->npkgs++;
+}
+
+/**
+ * Candidate names, installed packages of such a name are taken as being
+ * upgraded. As rpm does, an installed package of a (multilib) color the
+ * candidates don't have is kept, as are packages of the installonly names
+ * the caller passes.
+ */
+struct conflictNames_s {
+    strpool pool;
+    strpool installonly;
+    rpm_color_t * colors;	/*!< candidate colors by name id */
+    char * colorless;		/*!< candidate without color by name id? */
+    unsigned int nalloced;
+};
+
+static void conflictNameAdd(struct conflictNames_s * cn, const char * N,
+		rpm_color_t color)
+{
+    unsigned int id;
+
+    if (N == NULL || strpoolId(cn->installonly, N, 0))
+	return;
+    id = strpoolId(cn->pool, N, 1);
+    if (id >= cn->nalloced) {
+	unsigned int nalloced = 2 * id + 16;
+	cn->colors = xrealloc(cn->colors, nalloced * sizeof(*cn->colors));
+	cn->colorless = xrealloc(cn->colorless, nalloced * sizeof(*cn->colorless));
+	memset(cn->colors + cn->nalloced, 0,
+	       (nalloced - cn->nalloced) * sizeof(*cn->colors));
+	memset(cn->colorless + cn->nalloced, 0,
+	       (nalloced - cn->nalloced) * sizeof(*cn->colorless));
+	cn->nalloced = nalloced;
+    }
+    cn->colors[id] |= color;
+    if (color == 0)
+	cn->colorless[id] = 1;
+}
+
+/**
+ * Would installing the candidates upgrade (replace) an installed package?
+ */
+static int conflictNameUpgrades(struct conflictNames_s * cn, const char * N,
+		rpm_color_t color)
+{
+    unsigned int id = N ? strpoolId(cn->pool, N, 0) : 0;
+
+    if (id == 0)
+	return 0;
+    return (color == 0 || cn->colorless[id] || (cn->colors[id] & color));
+}
+
+/**
+ * Order files by path: basename, then directory fingerprint.
+ */
+static int conflictPathCmp(const struct conflictFile_s * fa,
+		const struct conflictFile_s * fb)
+{
+    const struct fprintCacheEntry_s * ea = fa->fp.entry, * eb = fb->fp.entry;
+
+    if (fa->bn != fb->bn)
+	return (fa->bn < fb->bn) ? -1 : 1;
+    if (ea->dev != eb->dev)
+	return (ea->dev < eb->dev) ? -1 : 1;
+    if (ea->ino != eb->ino)
+	return (ea->ino < eb->ino) ? -1 : 1;
+    if (fa->fp.subDir == NULL || fb->fp.subDir == NULL)
+	return (fa->fp.subDir != NULL) - (fb->fp.subDir != NULL);
+    return strcmp(fa->fp.subDir, fb->fp.subDir);
+}
+
+static int conflictFileCmp(const void * a, const void * b)
+{
+    const struct conflictFile_s * fa = a, * fb = b;
+    int rc = conflictPathCmp(fa, fb);
+
+    return rc ? rc : fa->owner - fb->owner;
+}
+
+/**
+ * Do two files conflict? Same rules as rpm: file type, link target and
+ * digest must match, %ghost files never conflict, nor do files of
+ * different colors (the preferred color wins on install).
+ */
+static int conflictCheck(struct conflictSet_s * cs,
+		struct conflictFile_s * a, struct conflictFile_s * b)
+{
+    rpmfi afi = cs->pkgs[a->owner].fi;
+    rpmfi bfi = cs->pkgs[b->owner].fi;
+    rpm_color_t acolor, bcolor;
+
+    (void) rpmfiSetFX(afi, a->fx);
+    (void) rpmfiSetFX(bfi, b->fx);
+
+    acolor = rpmfiFColor(afi);
+    bcolor = rpmfiFColor(bfi);
+    if (acolor && bcolor && !(acolor & bcolor))
+	return 0;
+
+    return rpmfiCompare(afi, bfi);
+}
+
+/**
+ * Sort the files and compare the files of each path pairwise, at least
+ * one side of a pair being a candidate.
+ */
+static void conflictFind(struct conflictSet_s * cs)
+{
+    int i, j, k;
+
+    qsort(cs->files, cs->nfiles, sizeof(*cs->files), conflictFileCmp);
+
+    for (i = 0; i < cs->nfiles; i = j) {
+	for (j = i + 1; j < cs->nfiles; j++) {
+	    if (conflictPathCmp(cs->files + j, cs->files + i))
+		break;
+	}
+	for (k = i; k < j; k++) {
+	    struct conflictFile_s * a = cs->files + k;
+	    int l;
+
+	    /* installed files sort last, only candidates start pairs */
+	    if (a->owner >= cs->ncandidates)
+		break;
+	    for (l = k + 1; l < j; l++) {
+		struct conflictFile_s * b = cs->files + l;
+		if (b->owner == a->owner || !conflictCheck(cs, a, b))
+		    continue;
+		if (cs->npairs == cs->npalloced) {
+		    cs->npalloced = cs->npalloced ? 2 * cs->npalloced : 64;
+		    cs->pairs = xrealloc(cs->pairs,
+				2 * cs->npalloced * sizeof(*cs->pairs));
+		}
+		cs->pairs[2 * cs->npairs] = k;
+		cs->pairs[2 * cs->npairs + 1] = l;
+		cs->npairs++;
+	    }
+	}
+    }
+}
+
+/**
+ * Has an installed package been looked at already? Remembers it if not.
+ * @param seen		looked at instances, sorted
+ */
+static int conflictSeen(unsigned int ** seen, int * nseen, unsigned int instance)
+{
+    int lo = 0, hi = *nseen;
+
+    while (lo < hi) {
+	int mid = (lo + hi) / 2;
+	if ((*seen)[mid] == instance)
+	    return 1;
+	if ((*seen)[mid] < instance)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    *seen = xrealloc(*seen, (*nseen + 1) * sizeof(**seen));
+    memmove(*seen + lo + 1, *seen + lo, (*nseen - lo) * sizeof(**seen));
+    (*seen)[lo] = instance;
+    (*nseen)++;
+    return 0;
+}
+
+/**
+ * Add the files of installed packages sharing a path with a candidate.
+ * Only the packages owning a candidate basename are loaded, from one
+ * basenames index read per basename. Installed packages the candidates
+ * upgrade are left out.
+ * @param mi		unkeyed basenames iterator (freed)
+ */
+static void conflictAddInstalled(struct conflictSet_s * cs,
+		rpmdbMatchIterator mi, struct conflictNames_s * names)
+{
+    unsigned int nbn = strpoolCount(cs->pool);
+    unsigned int * seen = NULL;
+    int nseen = 0;
+    int found = 0;
+    unsigned int id;
+    Header h;
+
+    for (id = 1; id <= nbn; id++) {
+	if (!rpmdbExtendIterator(mi, strpoolStr(cs->pool, id), 0))
+	    found = 1;
+    }
+
+    /* without a key set, the iterator would walk the whole index */
+    while (found && (h = rpmdbNextIterator(mi)) != NULL) {
+	unsigned int instance = rpmdbGetIteratorOffset(mi);
+	const char * N = NULL;
+	fingerPrint * dirfps;
+	rpmfi fi;
+	int owner = -1;
+
+	/* a package shows up once per matching file */
+	if (conflictSeen(&seen, &nseen, instance))
+	    continue;
+	if (headerNVR(h, &N, NULL, NULL) || N == NULL)
+	    continue;
+
+	fi = rpmfiInit(rpmfiNew(NULL, h, RPMTAG_BASENAMES, 0), 0);
+	if (conflictNameUpgrades(names, N, rpmfiColor(fi))) {
+	    fi = rpmfiFree(fi);
+	    continue;
+	}
+	dirfps = xcalloc(rpmfiDC(fi) + 1, sizeof(*dirfps));
+	while (rpmfiNext(fi) >= 0) {
+	    unsigned int bn = strpoolId(cs->pool, rpmfiBN(fi), 0);
+	    if (bn == 0)
+		continue;
+	    if (owner < 0)
+		owner = conflictAddPkg(cs, h, fi, -1, instance);
+	    conflictAddFile(cs, bn, conflictFingerprint(cs, fi, dirfps),
+			    owner, rpmfiFX(fi));
+	}
+	free(dirfps);
+	if (owner < 0)
+	    fi = rpmfiFree(fi);
+    }
+    free(seen);
+    mi = rpmdbFreeIterator(mi);
+}
+
+static PyObject * conflictRecord(struct conflictSet_s * cs,
+		struct conflictFile_s * a, struct conflictFile_s * b)
+{
+    struct conflictPkg_s * pa = cs->pkgs + a->owner;
+    struct conflictPkg_s * pb = cs->pkgs + b->owner;
+    PyObject * altPkg, * altInstance;
+    const char * fn;
+
+    (void) rpmfiSetFX(pa->fi, a->fx);
+    fn = rpmfiFN(pa->fi);
+
+    if (pb->pkg >= 0) {
+	altPkg = PyInt_FromLong(pb->pkg);
+	altInstance = Py_None;
+	Py_INCREF(altInstance);
+    } else {
+	altPkg = Py_None;
+	Py_INCREF(altPkg);
+	altInstance = PyInt_FromLong(pb->instance);
+    }
+    if (altPkg == NULL || altInstance == NULL) {
+	Py_XDECREF(altPkg);
+	Py_XDECREF(altInstance);
+	return NULL;
+    }
+
+    return Py_BuildValue("{s:s,s:i,s:s,s:N,s:N,s:s}",
+		"path", fn,
+		"pkg", pa->pkg,
+		"pkgNEVRA", pa->nevra,
+		"altPkg", altPkg,
+		"altInstance", altInstance,
+		"altNEVRA", pb->nevra);
+}
+
+PyObject * rpmFileConflicts(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    PyObject * headers, * seq, * tso = Py_None;
+    PyObject * installonly = Py_None, * ioseq = NULL;
+    PyObject * result = NULL;
+    struct conflictSet_s cs;
+    struct conflictNames_s names;
+    rpmdbMatchIterator mi = NULL;
+    Header * hdrs;
+    int i, n;
+    char * kwlist[] = {"headers", "ts", "installonly", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO:fileConflicts", kwlist,
+	    &headers, &tso, &installonly))
+	return NULL;
+
+    if (tso != Py_None && !PyObject_TypeCheck(tso, &rpmts_Type)) {
+	PyErr_SetString(PyExc_TypeError, "ts must be a transaction set");
+	return NULL;
+    }
+    if ((seq = PySequence_Fast(headers, "headers must be a sequence")) == NULL)
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    for (i = 0; i < n; i++) {
+	if (!PyObject_TypeCheck(PySequence_Fast_GET_ITEM(seq, i), &hdr_Type)) {
+	    PyErr_SetString(PyExc_TypeError, "headers must be rpm.hdr objects");
+	    Py_DECREF(seq);
+	    return NULL;
+	}
+    }
+
+    if (installonly != Py_None) {
+	ioseq = PySequence_Fast(installonly, "installonly must be a sequence");
+	if (ioseq == NULL) {
+	    Py_DECREF(seq);
+	    return NULL;
+	}
+	for (i = 0; i < PySequence_Fast_GET_SIZE(ioseq); i++) {
+	    if (!PyString_Check(PySequence_Fast_GET_ITEM(ioseq, i))) {
+		PyErr_SetString(PyExc_TypeError, "installonly must be names");
+		Py_DECREF(ioseq);
+		Py_DECREF(seq);
+		return NULL;
+	    }
+	}
+    }
+
+    memset(&cs, 0, sizeof(cs));
+    cs.pool = strpoolNew();
+    cs.fpc = fpCacheCreate(1024);
+    memset(&names, 0, sizeof(names));
+    names.pool = strpoolNew();
+    names.installonly = strpoolNew();
+    if (ioseq != NULL) {
+	for (i = 0; i < PySequence_Fast_GET_SIZE(ioseq); i++)
+	    (void) strpoolId(names.installonly,
+		PyString_AsString(PySequence_Fast_GET_ITEM(ioseq, i)), 1);
+	Py_DECREF(ioseq);
+    }
+
+    hdrs = xcalloc(n + 1, sizeof(*hdrs));
+    for (i = 0; i < n; i++)
+	hdrs[i] = hdrGetHeader((hdrObject *) PySequence_Fast_GET_ITEM(seq, i));
+
+    if (tso != Py_None) {
+	rpmtsObject * s = (rpmtsObject *) tso;
+	const char * root = rpmtsRootDir(s->ts);
+
+	/* fingerprint the installed tree, not the running system */
+	if (root != NULL && strcmp(root, "/")) {
+	    cs.root = xstrdup(root);
+	    for (i = strlen(cs.root); i > 0 && cs.root[i-1] == '/'; i--)
+		cs.root[i-1] = '\0';
+	}
+	if ((mi = rpmtsDbIterator(s, RPMTAG_BASENAMES, NULL, 0)) == NULL) {
+	    PyErr_SetString(pyrpmError, "rpmdb open failed");
+	    free(hdrs);
+	    goto exit;
+	}
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n; i++) {
+	Header h = hdrs[i];
+	const char * N = NULL;
+	rpmfi fi = rpmfiInit(rpmfiNew(NULL, h, RPMTAG_BASENAMES, 0), 0);
+	int owner = conflictAddPkg(&cs, h, fi, i, 0);
+	fingerPrint * dirfps = xcalloc(rpmfiDC(fi) + 1, sizeof(*dirfps));
+
+	(void) headerNVR(h, &N, NULL, NULL);
+
+	conflictNameAdd(&names, N, rpmfiColor(fi));
+	while (rpmfiNext(fi) >= 0) {
+	    conflictAddFile(&cs, strpoolId(cs.pool, rpmfiBN(fi), 1),
+			    conflictFingerprint(&cs, fi, dirfps),
+			    owner, rpmfiFX(fi));
+	}
+	free(dirfps);
+    }
+    cs.ncandidates = cs.npkgs;
+
+    debug("%d headers %d files\n", n, cs.nfiles);
+
+    if (mi)
+	conflictAddInstalled(&cs, mi, &names);
+    conflictFind(&cs);
+    Py_END_ALLOW_THREADS
+    free(hdrs);
+
+    result = PyList_New(cs.npairs);
+    for (i = 0; result != NULL && i < cs.npairs; i++) {
+	PyObject * o = conflictRecord(&cs, cs.files + cs.pairs[2 * i],
+				      cs.files + cs.pairs[2 * i + 1]);
+	if (o == NULL)
+	    Py_CLEAR(result);
+	else
+	    PyList_SET_ITEM(result, i, o);
+    }
+
+exit:
+    for (i = 0; i < cs.npkgs; i++) {
+	cs.pkgs[i].fi = rpmfiFree(cs.pkgs[i].fi);
+	free(cs.pkgs[i].nevra);
+    }
+    free(cs.pkgs);
+    free(cs.files);
+    free(cs.pairs);
+    cs.fpc = fpCacheFree(cs.fpc);
+    for (i = 0; i < cs.ndirs; i++)
+	free(cs.dirs[i]);
+    free(cs.dirs);
+    free(cs.root);
+    cs.pool = strpoolFree(cs.pool);
+    names.pool = strpoolFree(names.pool);
+    names.installonly = strpoolFree(names.installonly);
+    free(names.colors);
+    free(names.colorless);
+    Py_DECREF(seq);
+
+    return result;
+}
@@ -0,0 +1,16 @@
+#ifndef H_RPMCONFLICT_PY
+#define H_RPMCONFLICT_PY
+
+#include <Python.h>
+
+/** \ingroup py_c
+ * \file python/rpmconflict-py.h
+ */
+
+/**
+ * rpm.fileConflicts(headers, ts=None, installonly=None): find file conflicts
+ * among headers and, given a transaction set, with the installed packages.
+ */
+PyObject * rpmFileConflicts(PyObject * self, PyObject * args, PyObject * kwds);
+
+#endif
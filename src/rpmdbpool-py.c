@@ -0,0 +1,222 @@
+/** \ingroup py_c
+ * \file python/rpmdbpool-py.c
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpm/rpmfileutil.h>
+#include <rpm/rpmstring.h>
+
+#include "rpmdbpool-py.h"
+
+/**
+ * A pooled handle, one per root directory and thread: rpmdb handles
+ * are not thread safe, each thread only ever iterates its own. Detached
+ * handles are bound to no thread, they are checked out for exclusive
+ * use instead.
+ */
+struct dbPoolEntry_s {
+    pthread_t thread;
+    int detached;		/*!< see rpmdbPoolAcquire() */
+    int busy;			/*!< detached handle checked out? */
+    char * root;
+    char * pkgpath;		/*!< Packages file, for change detection */
+    rpmdb db;			/*!< the pool's own reference */
+    struct rpmdbStamp_s stamp;
+    struct dbPoolEntry_s * next;
+};
+
+static struct dbPoolEntry_s * dbPool = NULL;
+static pthread_mutex_t dbPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t dbPoolKey;	/*!< set in threads owning entries */
+static pthread_once_t dbPoolOnce = PTHREAD_ONCE_INIT;
+
+static void dbPoolEntryFree(struct dbPoolEntry_s * e)
+{
+    if (e->db)
+	(void) rpmdbClose(e->db);
+    free(e->root);
+    free(e->pkgpath);
+    free(e);
+}
+
+/**
+ * Thread exit: drop the entries of the thread, the thread ids may be
+ * reused by later threads.
+ */
+static void dbPoolThreadExit(void * arg)
+{
+    pthread_t self = pthread_self();
+    struct dbPoolEntry_s ** ep, * e;
+
+    pthread_mutex_lock(&dbPoolLock);
+    ep = &dbPool;
+    while ((e = *ep) != NULL) {
+	if (!e->detached && pthread_equal(e->thread, self)) {
+	    *ep = e->next;
+	    dbPoolEntryFree(e);
+	} else
+	    ep = &e->next;
+    }
+    pthread_mutex_unlock(&dbPoolLock);
+}
+
+static void dbPoolKeyCreate(void)
+{
+    (void) pthread_key_create(&dbPoolKey, dbPoolThreadExit);
+}
+
+int rpmdbStampCheck(const char * pkgpath, struct rpmdbStamp_s * stamp,
+		    int update)
+{
+    struct stat sb;
+    int changed;
+
+    if (stat(pkgpath, &sb))
+	memset(&sb, 0, sizeof(sb));
+    changed = (sb.st_dev != stamp->dev || sb.st_ino != stamp->ino
+	    || sb.st_size != stamp->size || sb.st_mtime != stamp->mtime);
+    if (update) {
+	stamp->dev = sb.st_dev;
+	stamp->ino = sb.st_ino;
+	stamp->size = sb.st_size;
+	stamp->mtime = sb.st_mtime;
+    }
+    return changed;
+}
+
+static struct dbPoolEntry_s * dbPoolEntryNew(const char * root)
+{
+    struct dbPoolEntry_s * e = xcalloc(1, sizeof(*e));
+
+    e->root = xstrdup(root);
+    e->pkgpath = rpmGenPath(root, "%{_dbpath}", "Packages");
+    e->next = dbPool;
+    dbPool = e;
+    return e;
+}
+
+/**
+ * Return a new reference to the db of an entry, (re)opening it first if
+ * needed. Called with the pool locked.
+ */
+static rpmdb dbPoolEntryLink(struct dbPoolEntry_s * e, const char * msg)
+{
+    /* Drop the pool reference to a changed db, users keep theirs. */
+    if (e->db != NULL && rpmdbStampCheck(e->pkgpath, &e->stamp, 0)) {
+	(void) rpmdbClose(e->db);
+	e->db = NULL;
+    }
+    if (e->db == NULL) {
+	(void) rpmdbStampCheck(e->pkgpath, &e->stamp, 1);
+	if (rpmdbOpen(e->root, &e->db, O_RDONLY, 0644))
+	    e->db = NULL;
+    }
+    return e->db ? rpmdbLink(e->db, msg) : NULL;
+}
+
+rpmdb rpmdbPoolGet(const char * root)
+{
+    struct dbPoolEntry_s * e;
+    pthread_t self = pthread_self();
+    rpmdb db;
+
+    if (root == NULL)
+	root = "/";
+
+    pthread_mutex_lock(&dbPoolLock);
+    for (e = dbPool; e != NULL; e = e->next) {
+	if (!e->detached && pthread_equal(e->thread, self)
+	 && !strcmp(e->root, root))
+	    break;
+    }
+    if (e == NULL) {
+	e = dbPoolEntryNew(root);
+	e->thread = self;
+	/* any non-NULL value gets the destructor called */
+	(void) pthread_once(&dbPoolOnce, dbPoolKeyCreate);
+	(void) pthread_setspecific(dbPoolKey, e);
+    }
+    db = dbPoolEntryLink(e, "rpmdbPoolGet");
+    pthread_mutex_unlock(&dbPoolLock);
+
+    return db;
+}
+
+rpmdb rpmdbPoolAcquire(const char * root)
+{
+    struct dbPoolEntry_s * e;
+    rpmdb db;
+
+    if (root == NULL)
+	root = "/";
+
+    pthread_mutex_lock(&dbPoolLock);
+    for (e = dbPool; e != NULL; e = e->next) {
+	if (e->detached && !e->busy && !strcmp(e->root, root))
+	    break;
+    }
+    if (e == NULL) {
+	e = dbPoolEntryNew(root);
+	e->detached = 1;
+    }
+    if ((db = dbPoolEntryLink(e, "rpmdbPoolAcquire")) != NULL)
+	e->busy = 1;
+    pthread_mutex_unlock(&dbPoolLock);
+
+    return db;
+}
+
+rpmdb rpmdbPoolRelease(rpmdb db)
+{
+    struct dbPoolEntry_s * e;
+
+    if (db == NULL)
+	return NULL;
+
+    pthread_mutex_lock(&dbPoolLock);
+    for (e = dbPool; e != NULL; e = e->next) {
+	if (e->detached && e->busy && e->db == db) {
+	    e->busy = 0;
+	    break;
+	}
+    }
+    (void) rpmdbClose(db);
+    pthread_mutex_unlock(&dbPoolLock);
+
+    return NULL;
+}
+
+rpmdb rpmdbPoolPut(rpmdb db)
+{
+    /* rpmdbClose() only closes once the last reference is gone */
+    if (db != NULL) {
+	pthread_mutex_lock(&dbPoolLock);
+	(void) rpmdbClose(db);
+	pthread_mutex_unlock(&dbPoolLock);
+    }
+    return NULL;
+}
+
+void rpmdbPoolFlush(void)
+{
+    struct dbPoolEntry_s ** ep, * e;
+
+    pthread_mutex_lock(&dbPoolLock);
+    ep = &dbPool;
+    while ((e = *ep) != NULL) {
+	/* checked out handles are in use by another thread */
+	if (e->busy) {
+	    ep = &e->next;
+	    continue;
+	}
+	*ep = e->next;
+	dbPoolEntryFree(e);
+    }
+    pthread_mutex_unlock(&dbPoolLock);
+}
@@ -0,0 +1,74 @@
+#ifndef H_RPMDBPOOL_PY
+#define H_RPMDBPOOL_PY
+
+#include <sys/types.h>
+#include <time.h>
+#include <rpm/rpmdb.h>
+
+/** \ingroup py_c
+ * \file python/rpmdbpool-py.h
+ */
+
+/**
+ * Identity of an rpmdb Packages file, for change detection.
+ */
+struct rpmdbStamp_s {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+};
+
+/**
+ * Has an rpmdb changed since its stamp was taken?
+ * @param pkgpath	path of the Packages file
+ * @param stamp		previous stamp (all zero if never taken)
+ * @param update	retake the stamp?
+ * @return		1 if changed, 0 otherwise
+ */
+int rpmdbStampCheck(const char * pkgpath, struct rpmdbStamp_s * stamp,
+		    int update);
+
+/**
+ * Borrow the calling thread's read-only rpmdb handle of a root directory.
+ * The handle is opened on first use and reopened once the Packages file
+ * has changed. Users holding (or iterating) an older handle keep it
+ * alive through the rpmdb reference count. Handles must not be passed
+ * on to other threads. The handles of a thread are dropped as it exits.
+ * @param root		root directory
+ * @return		linked rpmdb handle, NULL if the rpmdb can't be opened
+ */
+rpmdb rpmdbPoolGet(const char * root);
+
+/**
+ * Return a borrowed rpmdb handle.
+ * @param db		handle from rpmdbPoolGet()
+ * @return		NULL always
+ */
+rpmdb rpmdbPoolPut(rpmdb db);
+
+/**
+ * Check out an idle read-only rpmdb handle of a root directory, bound
+ * to no thread: it may be used by any one thread until it is released.
+ * Released handles stay open for the next rpmdbPoolAcquire(), they are
+ * reopened once the Packages file has changed.
+ * @param root		root directory
+ * @return		linked rpmdb handle, NULL if the rpmdb can't be opened
+ */
+rpmdb rpmdbPoolAcquire(const char * root);
+
+/**
+ * Return a handle checked out with rpmdbPoolAcquire().
+ * @param db		handle from rpmdbPoolAcquire()
+ * @return		NULL always
+ */
+rpmdb rpmdbPoolRelease(rpmdb db);
+
+/**
+ * Close all pooled handles (of all threads) not in use elsewhere.
+ * Handles checked out with rpmdbPoolAcquire() are kept.
+ * Other threads must not be querying pooled handles meanwhile.
+ */
+void rpmdbPoolFlush(void);
+
+#endif
@@ -126,32 +126,142 @@ static int compare_values(const char *str1, const char *str2)
     return rpmvercmp(str1, str2);
 }
 
+void dsSplitEVR(struct dsEVR_s * evr, const char * EVR)
+{
+    evr->buf = xstrdup(EVR ? EVR : "");
+    evr->empty = (evr->buf[0] == '\0');
+    rpmds_ParseEVR(evr->buf, &evr->E, &evr->V, &evr->R);
+}
+
+static void dsFreeEVRs(rpmdsObject * s)
+{
+    int i;
+
+    for (i = 0; i < s->nevrs; i++)
+	free(s->evrs[i].buf);
+    free(s->evrs);
+    s->evrs = NULL;
+    s->nevrs = 0;
+}
+
+/**
+ * Return the split EVR of the current entry, parsing it on first use.
+ */
+static struct dsEVR_s * dsCurrentEVR(rpmdsObject * s)
+{
+    struct dsEVR_s * evr;
+    int ix = rpmdsIx(s->ds);
+    int count = rpmdsCount(s->ds);
+
+    /* The set may have grown behind our back, start over then. */
+    if (s->nevrs != count) {
+	dsFreeEVRs(s);
+	if (count > 0) {
+	    s->evrs = xcalloc(count, sizeof(*s->evrs));
+	    s->nevrs = count;
+	}
+    }
+    if (ix < 0 || ix >= count)
+	return NULL;
+
+    evr = s->evrs + ix;
+    if (evr->buf == NULL)
+	dsSplitEVR(evr, rpmdsEVR(s->ds));
+    return evr;
+}
+
 static int
 rpmds_compare(rpmdsObject * a, rpmdsObject * b)
 {
-    char *aEVR = strdup(rpmdsEVR(a->ds));
-    const char *aE, *aV, *aR;
-    char *bEVR = strdup(rpmdsEVR(b->ds));
-    const char *bE, *bV, *bR;
+    struct dsEVR_s * aevr, * bevr;
+    int aix = rpmdsIx(a->ds);
+    int bix = rpmdsIx(b->ds);
     int rc;
 
-    /* XXX W2DO? should N be compared? */
-    rpmds_ParseEVR(aEVR, &aE, &aV, &aR);
-    rpmds_ParseEVR(bEVR, &bE, &bV, &bR);
+    /* XXX make sure the indices are valid, as rpmds_Find() does. */
+    if (aix == -1)	rpmdsSetIx(a->ds, 0);
+    if (bix == -1)	rpmdsSetIx(b->ds, 0);
 
-    rc = compare_values(aE, bE);
-    if (!rc) {
-	rc = compare_values(aV, bV);
-	if (!rc)
-	    rc = compare_values(aR, bR);
+    aevr = dsCurrentEVR(a);
+    bevr = dsCurrentEVR(b);
+    if (aevr == NULL || bevr == NULL) {
+	rc = (aevr != NULL) - (bevr != NULL);
+    } else {
+	/* XXX W2DO? should N be compared? */
+	rc = compare_values(aevr->E, bevr->E);
+	if (!rc) {
+	    rc = compare_values(aevr->V, bevr->V);
+	    if (!rc)
+		rc = compare_values(aevr->R, bevr->R);
+	}
     }
 
-    free(aEVR);
-    free(bEVR);
+    /* leave unstarted iterations unstarted (b first, a and b may be one) */
+    (void) rpmdsSetIx(b->ds, bix);
+    (void) rpmdsSetIx(a->ds, aix);
 
     return rc;
 }
 
+int dsOverlapEVR(rpmsenseFlags aF, const struct dsEVR_s * aevr,
+		rpmsenseFlags bF, const struct dsEVR_s * bevr, int nopromote)
+{
+    int sense = 0;
+
+    /* If either A or B is an existence test, always overlap. */
+    if (!((aF & RPMSENSE_SENSEMASK) && (bF & RPMSENSE_SENSEMASK)))
+	return 1;
+
+    /* If either EVR is non-existent or empty, always overlap. */
+    if (aevr == NULL || bevr == NULL || aevr->empty || bevr->empty)
+	return 1;
+
+    /* Compare {A,B} [epoch:]version[-release], as rpmdsCompare() does. */
+    if (aevr->E && *aevr->E && bevr->E && *bevr->E)
+	sense = rpmvercmp(aevr->E, bevr->E);
+    else if (aevr->E && *aevr->E && atol(aevr->E) > 0)
+	sense = nopromote ? 1 : 0;
+    else if (bevr->E && *bevr->E && atol(bevr->E) > 0)
+	sense = -1;
+
+    if (sense == 0) {
+	sense = rpmvercmp(aevr->V, bevr->V);
+	if (sense == 0 && aevr->R && *aevr->R && bevr->R && *bevr->R)
+	    sense = rpmvercmp(aevr->R, bevr->R);
+    }
+
+    /* Detect overlap of {A,B} range. */
+    if (sense < 0 && ((aF & RPMSENSE_GREATER) || (bF & RPMSENSE_LESS)))
+	return 1;
+    if (sense > 0 && ((aF & RPMSENSE_LESS) || (bF & RPMSENSE_GREATER)))
+	return 1;
+    if (sense == 0 &&
+	(((aF & RPMSENSE_EQUAL) && (bF & RPMSENSE_EQUAL)) ||
+	 ((aF & RPMSENSE_LESS) && (bF & RPMSENSE_LESS)) ||
+	 ((aF & RPMSENSE_GREATER) && (bF & RPMSENSE_GREATER))))
+	return 1;
+    return 0;
+}
+
+int dsOverlap(rpmdsObject * a, rpmdsObject * b)
+{
+    rpmsenseFlags aF = rpmdsFlags(a->ds);
+    rpmsenseFlags bF = rpmdsFlags(b->ds);
+    const char * aN = rpmdsN(a->ds);
+    const char * bN = rpmdsN(b->ds);
+
+    /* Different names don't overlap. */
+    if (aN == NULL || bN == NULL || strcmp(aN, bN))
+	return 0;
+
+    /* Only parse EVRs if there are ranges to compare. */
+    if (!((aF & RPMSENSE_SENSEMASK) && (bF & RPMSENSE_SENSEMASK)))
+	return 1;
+
+    return dsOverlapEVR(aF, dsCurrentEVR(a), bF, dsCurrentEVR(b),
+			rpmdsNoPromote(b->ds));
+}
+
 static PyObject *
 rpmds_richcompare(rpmdsObject * a, rpmdsObject * b, int op)
 {
@@ -160,8 +270,8 @@ rpmds_richcompare(rpmdsObject * a, rpmdsObject * b, int op)
     switch (op) {
     case Py_NE:
 	/* XXX map ranges overlap boolean onto '!=' python syntax. */
-	rc = rpmdsCompare(a->ds, b->ds);
-	rc = (rc < 0 ? -1 : (rc == 0 ? 1 : 0));
+	rc = dsOverlap(a, b);
+	rc = (rc == 0 ? 1 : 0);
 	break;
     case Py_LT:
     case Py_LE:
@@ -266,6 +376,8 @@ rpmds_Merge(rpmdsObject * s, PyObject * args, PyObject * kwds)
 	return NULL;
     }
 
+    /* Entries move around, drop the parsed EVRs. */
+    dsFreeEVRs(s);
     return Py_BuildValue("i", rpmdsMerge(&s->ds, o->ds));
 }
 static PyObject *
@@ -342,6 +454,7 @@ static void
 rpmds_dealloc(rpmdsObject * s)
 {
     if (s) {
+	dsFreeEVRs(s);
 	s->ds = rpmdsFree(s->ds);
 	PyObject_Del(s);
     }
@@ -396,6 +509,7 @@ static int rpmds_init(rpmdsObject * s, PyObject *args, PyObject *kwds)
 static void rpmds_free(rpmdsObject * s)
 {
     debug("%p -- ds %p\n", s, s->ds);
+    dsFreeEVRs(s);
     s->ds = rpmdsFree(s->ds);
 
     PyObject_Del((PyObject *)s);
@@ -556,6 +670,43 @@ rpmds dsFromDs(rpmdsObject * s)
     return s->ds;
 }
 
+rpmds dsSingleFromPyObject(PyObject * o, rpmTag tagN)
+{
+    rpmds ds = NULL;
+
+    if (PyObject_TypeCheck(o, &rpmds_Type)) {
+	rpmds ods = ((rpmdsObject *) o)->ds;
+	int oix = rpmdsIx(ods);
+	int ix = oix;
+
+	/* An unstarted iteration means the first entry, the caller's
+	 * index is put back afterwards. */
+	if (ix == -1) {
+	    ix = 0;
+	    (void) rpmdsSetIx(ods, ix);
+	}
+	if (ix < rpmdsCount(ods) && rpmdsN(ods) != NULL)
+	    ds = rpmdsSingle(tagN, rpmdsN(ods), rpmdsEVR(ods), rpmdsFlags(ods));
+	if (oix != ix)
+	    (void) rpmdsSetIx(ods, oix);
+    } else if (PyTuple_Check(o) && PyTuple_Size(o) == 3) {
+	char *n, *evr;
+	rpmsenseFlags flags;
+
+	if (!PyArg_ParseTuple(o, "siz", &n, &flags, &evr))
+	    return NULL;
+	ds = rpmdsSingle(tagN, n, evr ? evr : "", flags);
+    } else if (PyString_Check(o)) {
+	ds = rpmdsSingle(tagN, PyString_AsString(o), "", RPMSENSE_ANY);
+    }
+
+    /* Keep a more specific exception of the conversions above. */
+    if (ds == NULL && !PyErr_Occurred()) {
+	PyErr_SetString(PyExc_TypeError, "ds, (N, Flags, EVR) tuple or name expected");
+    }
+    return ds;
+}
+
 PyObject *
 rpmds_Wrap(rpmds ds)
 {
@@ -566,5 +717,7 @@ rpmds_Wrap(rpmds ds)
     }
     s->ds = ds;
     s->cur = NULL;
+    s->evrs = NULL;
+    s->nevrs = 0;
     return (PyObject*) s;
 }
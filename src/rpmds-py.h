@@ -20,6 +20,8 @@ typedef struct rpmdsObject_s {
     PyObject_HEAD
     rpmdsDepObject * cur;
     rpmds ds;
+    struct dsEVR_s * evrs;	/*!< parsed EVR per entry, on demand */
+    int nevrs;
 } rpmdsObject;
 
 /**
@@ -31,6 +33,55 @@ extern PyTypeObject rpmdsDep_Type;
  */
 rpmds dsFromDs(rpmdsObject * ds);
 
+/**
+ * Create a single element dependency set from an rpm.ds object (using its
+ * current entry), a (N, Flags, EVR) tuple or a plain name string.
+ * Sets python error on failure.
+ * @param o		python object
+ * @param tagN		dependency tag of the new set
+ * @return		new dependency set (or NULL)
+ */
+rpmds dsSingleFromPyObject(PyObject * o, rpmTag tagN);
+
+/**
+ * A split [epoch:]version[-release].
+ */
+struct dsEVR_s {
+    char * buf;			/*!< split copy of the EVR, NULL if not yet */
+    const char * E;		/*!< NULL if there's no epoch */
+    const char * V;
+    const char * R;		/*!< NULL if there's no release */
+    int empty;			/*!< was the EVR empty? */
+};
+
+/**
+ * Split an EVR string, free evr->buf when done.
+ * @retval evr		split EVR
+ * @param EVR		[epoch:]version[-release] string (or NULL)
+ */
+void dsSplitEVR(struct dsEVR_s * evr, const char * EVR);
+
+/**
+ * Do two ranges overlap? Same rules as rpmdsCompare(A, B), on split EVRs.
+ * @param aF		A sense flags
+ * @param aevr		A EVR (or NULL)
+ * @param bF		B sense flags
+ * @param bevr		B EVR (or NULL)
+ * @param nopromote	B no promote flag
+ * @return		1 if the ranges overlap, 0 otherwise
+ */
+int dsOverlapEVR(rpmsenseFlags aF, const struct dsEVR_s * aevr,
+		rpmsenseFlags bF, const struct dsEVR_s * bevr, int nopromote);
+
+/**
+ * Do the ranges of the current entries of two rpm.ds objects overlap?
+ * Same as rpmdsCompare(), but parsed EVRs are cached in the objects.
+ * @param a		1st dependency set (current entry)
+ * @param b		2nd dependency set (current entry)
+ * @return		1 if the ranges overlap, 0 otherwise
+ */
+int dsOverlap(rpmdsObject * a, rpmdsObject * b);
+
 /**
  */
 PyObject * rpmds_Wrap(rpmds ds);
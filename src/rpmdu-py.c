@@ -0,0 +1,328 @@
+/** \ingroup py_c
+ * \file python/rpmdu-py.c
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpm/rpmstring.h>
+
+#include "header-py.h"
+#include "rpmdu-py.h"
+#include "strpool-py.h"
+#include "rpmdebug-py.h"
+
+/** Marks a dirname not looked up yet. */
+#define	DU_UNKNOWN	(-2)
+
+/**
+ * A filesystem files go to.
+ */
+struct duFS_s {
+    dev_t dev;
+    char * mntPoint;
+    unsigned long bsize;
+    long long bavail;		/*!< bytes available to unprivileged users */
+    long long iavail;		/*!< inodes available */
+    long long bneeded;		/*!< bytes, block rounded */
+    long long ineeded;
+};
+
+struct rpmdu_s {
+    char * rootDir;		/*!< without trailing slash, "" for / */
+    struct duFS_s * fs;
+    int nfs;
+    strpool dirs;		/*!< dirnames seen */
+    int * dirFS;		/*!< filesystem of each dirname id */
+    unsigned int ndirFS;
+};
+
+rpmdu rpmduNew(const char * rootDir)
+{
+    rpmdu du = xcalloc(1, sizeof(*du));
+    size_t len;
+
+    du->rootDir = xstrdup(rootDir ? rootDir : "");
+    len = strlen(du->rootDir);
+    while (len > 0 && du->rootDir[len - 1] == '/')
+	du->rootDir[--len] = '\0';
+    du->dirs = strpoolNew();
+    return du;
+}
+
+rpmdu rpmduFree(rpmdu du)
+{
+    int i;
+
+    if (du) {
+	for (i = 0; i < du->nfs; i++)
+	    free(du->fs[i].mntPoint);
+	free(du->fs);
+	free(du->dirFS);
+	du->dirs = strpoolFree(du->dirs);
+	free(du->rootDir);
+	free(du);
+    }
+    return NULL;
+}
+
+/**
+ * Return the filesystem of an existing path, adding it on first sight.
+ */
+static int duFileSystem(rpmdu du, const char * path, dev_t dev)
+{
+    struct duFS_s * fs;
+    struct statvfs sfb;
+    struct stat sb;
+    char * mnt, * slash;
+    int i;
+
+    for (i = 0; i < du->nfs; i++) {
+	if (du->fs[i].dev == dev)
+	    return i;
+    }
+
+    /* The mount point is the topmost directory on the same device. */
+    mnt = xstrdup(path);
+    while ((slash = strrchr(mnt, '/')) != NULL && slash != mnt) {
+	*slash = '\0';
+	if (stat(mnt, &sb) || sb.st_dev != dev) {
+	    *slash = '/';
+	    break;
+	}
+    }
+    if (slash == mnt && mnt[1] != '\0') {
+	if (stat("/", &sb) == 0 && sb.st_dev == dev)
+	    mnt[1] = '\0';
+    }
+
+    du->fs = xrealloc(du->fs, (du->nfs + 1) * sizeof(*du->fs));
+    fs = du->fs + du->nfs;
+    memset(fs, 0, sizeof(*fs));
+    fs->dev = dev;
+    fs->mntPoint = mnt;
+    if (statvfs(path, &sfb) == 0) {
+	fs->bsize = sfb.f_frsize ? sfb.f_frsize : sfb.f_bsize;
+	fs->bavail = (long long) sfb.f_bavail * fs->bsize;
+	fs->iavail = (sfb.f_ffree == 0 && sfb.f_files == 0) ? -1 : sfb.f_favail;
+    } else {
+	fs->bsize = 4096;
+	fs->bavail = fs->iavail = -1;
+    }
+    return du->nfs++;
+}
+
+/**
+ * Return the filesystem of a dirname, stat()ing each dirname once.
+ * Dirnames not there yet are looked up through their parents.
+ * @param du		disk usage account
+ * @param dn		dirname (with trailing slash)
+ * @param len		length of dn
+ * @return		filesystem index, -1 if unknown
+ */
+static int duDirFS(rpmdu du, const char * dn, int len)
+{
+    unsigned int id = strpoolIdn(du->dirs, dn, len, 1);
+    struct stat sb;
+    char * path;
+    int fs;
+
+    if (id >= du->ndirFS) {
+	unsigned int i, n = 2 * id + 16;
+	du->dirFS = xrealloc(du->dirFS, n * sizeof(*du->dirFS));
+	for (i = du->ndirFS; i < n; i++)
+	    du->dirFS[i] = DU_UNKNOWN;
+	du->ndirFS = n;
+    }
+    if (du->dirFS[id] != DU_UNKNOWN)
+	return du->dirFS[id];
+
+    path = xmalloc(strlen(du->rootDir) + len + 1);
+    strcpy(path, du->rootDir);
+    strncat(path, dn, len);
+    if (stat(path, &sb) == 0) {
+	fs = duFileSystem(du, path, sb.st_dev);
+    } else if (len > 1) {
+	/* strip the last component, keeping the trailing slash */
+	int plen = len - 1;
+	while (plen > 0 && dn[plen - 1] != '/')
+	    plen--;
+	fs = (plen > 0) ? duDirFS(du, dn, plen) : -1;
+    } else {
+	fs = -1;
+    }
+    free(path);
+
+    du->dirFS[id] = fs;
+    return fs;
+}
+
+/**
+ * Does the current file of a file info set take space on install?
+ */
+static int duCounted(rpmfi fi)
+{
+    /* %ghost files aren't part of the payload */
+    if (rpmfiFFlags(fi) & RPMFILE_GHOST)
+	return 0;
+    switch (rpmfiFState(fi)) {
+    case RPMFILE_STATE_NETSHARED:
+    case RPMFILE_STATE_REPLACED:
+    case RPMFILE_STATE_NOTINSTALLED:
+    case RPMFILE_STATE_WRONGCOLOR:
+	return 0;
+    default:
+	return 1;
+    }
+}
+
+static void duAccount(rpmdu du, const char * dn, rpm_loff_t size, int sign)
+{
+    struct duFS_s * fs;
+    int fsx;
+
+    if ((fsx = duDirFS(du, dn, strlen(dn))) < 0)
+	return;
+    fs = du->fs + fsx;
+    fs->bneeded += sign * (long long)
+	    (((size + fs->bsize - 1) / fs->bsize) * fs->bsize);
+    fs->ineeded += sign;
+}
+
+void rpmduAdd(rpmdu du, rpmfi fi, int sign)
+{
+    fi = rpmfiInit(fi, 0);
+    while (rpmfiNext(fi) >= 0) {
+	if (duCounted(fi))
+	    duAccount(du, rpmfiDN(fi), rpmfiFSize(fi), sign);
+    }
+}
+
+/**
+ * A counted file of a package, see rpmduPkgNew().
+ */
+struct duFile_s {
+    const char * dn;		/*!< points into the file info set */
+    rpm_loff_t size;
+};
+
+struct rpmduPkg_s {
+    rpmfi fi;			/*!< linked, keeps the dirnames alive */
+    int sign;
+    int nfiles;
+    struct duFile_s * files;
+};
+
+rpmduPkg rpmduPkgNew(rpmfi fi, int sign)
+{
+    rpmduPkg pkg = xcalloc(1, sizeof(*pkg));
+    int fx = rpmfiFX(fi);
+
+    pkg->fi = rpmfiLink(fi, "rpmduPkgNew");
+    pkg->sign = sign;
+    pkg->files = xcalloc(rpmfiFC(fi) + 1, sizeof(*pkg->files));
+    fi = rpmfiInit(fi, 0);
+    while (rpmfiNext(fi) >= 0) {
+	if (!duCounted(fi))
+	    continue;
+	pkg->files[pkg->nfiles].dn = rpmfiDN(fi);
+	pkg->files[pkg->nfiles].size = rpmfiFSize(fi);
+	pkg->nfiles++;
+    }
+
+    /* leave the cursor where the owner had it */
+    if (fx >= 0)
+	(void) rpmfiSetFX(fi, fx);
+    else
+	fi = rpmfiInit(fi, 0);
+    return pkg;
+}
+
+void rpmduAddPkg(rpmdu du, rpmduPkg pkg)
+{
+    int i;
+
+    for (i = 0; i < pkg->nfiles; i++)
+	duAccount(du, pkg->files[i].dn, pkg->files[i].size, pkg->sign);
+}
+
+rpmduPkg rpmduPkgFree(rpmduPkg pkg)
+{
+    if (pkg) {
+	pkg->fi = rpmfiFree(pkg->fi);
+	free(pkg->files);
+	free(pkg);
+    }
+    return NULL;
+}
+
+PyObject * rpmduDict(rpmdu du)
+{
+    PyObject * dict = PyDict_New();
+    int i;
+
+    for (i = 0; dict && i < du->nfs; i++) {
+	struct duFS_s * fs = du->fs + i;
+	PyObject * o = Py_BuildValue("{s:L,s:L,s:L,s:L,s:k}",
+		"bytes", fs->bneeded,
+		"inodes", fs->ineeded,
+		"bavail", fs->bavail,
+		"iavail", fs->iavail,
+		"bsize", fs->bsize);
+	if (o == NULL || PyDict_SetItemString(dict, fs->mntPoint, o)) {
+	    Py_XDECREF(o);
+	    Py_DECREF(dict);
+	    return NULL;
+	}
+	Py_DECREF(o);
+    }
+    return dict;
+}
+
+PyObject * rpmDiskUsage(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    PyObject * headers, * seq, * result;
+    const char * rootDir = "/";
+    Header * hdrs;
+    rpmdu du;
+    int i, n;
+    char * kwlist[] = {"headers", "rootDir", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|s:diskUsage", kwlist,
+	    &headers, &rootDir))
+	return NULL;
+
+    if ((seq = PySequence_Fast(headers, "headers must be a sequence")) == NULL)
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    hdrs = xcalloc(n + 1, sizeof(*hdrs));
+    for (i = 0; i < n; i++) {
+	PyObject * o = PySequence_Fast_GET_ITEM(seq, i);
+	if (!PyObject_TypeCheck(o, &hdr_Type)) {
+	    PyErr_SetString(PyExc_TypeError, "headers must be rpm.hdr objects");
+	    free(hdrs);
+	    Py_DECREF(seq);
+	    return NULL;
+	}
+	hdrs[i] = hdrGetHeader((hdrObject *) o);
+    }
+
+    du = rpmduNew(rootDir);
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n; i++) {
+	rpmfi fi = rpmfiNew(NULL, hdrs[i], RPMTAG_BASENAMES, 0);
+	rpmduAdd(du, fi, 1);
+	fi = rpmfiFree(fi);
+    }
+    Py_END_ALLOW_THREADS
+
+    result = rpmduDict(du);
+    du = rpmduFree(du);
+    free(hdrs);
+    Py_DECREF(seq);
+
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef H_RPMDU_PY
+#define H_RPMDU_PY
+
+#include <Python.h>
+
+#include <rpm/rpmfi.h>
+
+/** \ingroup py_c
+ * \file python/rpmdu-py.h
+ */
+
+/**
+ * Disk usage accounting of file sets, per filesystem.
+ */
+typedef struct rpmdu_s * rpmdu;
+
+/**
+ * Create an empty disk usage account.
+ * @param rootDir	root directory (or NULL)
+ */
+rpmdu rpmduNew(const char * rootDir);
+
+/**
+ * Free a disk usage account.
+ * @return		NULL always
+ */
+rpmdu rpmduFree(rpmdu du);
+
+/**
+ * Account for the files of a package being installed or erased.
+ * Safe to call without the GIL.
+ * @param du		disk usage account
+ * @param fi		file info set
+ * @param sign		1 for install, -1 for erase
+ */
+void rpmduAdd(rpmdu du, rpmfi fi, int sign);
+
+/**
+ * The files of a package to account, copied out of a file info set that
+ * other threads may use, so that they can be accounted without the GIL.
+ */
+typedef struct rpmduPkg_s * rpmduPkg;
+
+/**
+ * Copy the files of a package to account. Call with the GIL held, the
+ * cursor of fi is left as it was.
+ * @param fi		file info set (linked)
+ * @param sign		1 for install, -1 for erase
+ */
+rpmduPkg rpmduPkgNew(rpmfi fi, int sign);
+
+/**
+ * Account for the files of a package. Safe to call without the GIL.
+ */
+void rpmduAddPkg(rpmdu du, rpmduPkg pkg);
+
+/**
+ * Free the files of a package.
+ * @return		NULL always
+ */
+rpmduPkg rpmduPkgFree(rpmduPkg pkg);
+
+/**
+ * Return the account as a python dict, keyed by mount point.
+ */
+PyObject * rpmduDict(rpmdu du);
+
+/**
+ * rpm.diskUsage(headers, rootDir="/"): space needed to install headers.
+ */
+PyObject * rpmDiskUsage(PyObject * self, PyObject * args, PyObject * kwds);
+
+#endif
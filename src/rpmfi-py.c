@@ -3,9 +3,12 @@
  */
 
 #include <rpm/rpmtag.h>
+#include <rpm/rpmstring.h>
 
 #include "header-py.h"
 #include "rpmfi-py.h"
+#include "rpmthread-py.h"
+#include "rpmverify-py.h"
 #include "rpmdebug-py.h"
 
 static PyObject *
@@ -173,6 +176,500 @@ rpmfi_iternext(rpmfiObject * s)
     return result;
 }
 
+/**
+ * Columns available through fi.column(), numeric ones carry the array
+ * typecode of their values.
+ */
+enum fiColumn_e {
+    FICOL_BN, FICOL_DN, FICOL_FN, FICOL_FLINK, FICOL_FUSER, FICOL_FGROUP,
+    FICOL_FCLASS, FICOL_DIGEST,
+    FICOL_FFLAGS, FICOL_VFLAGS, FICOL_FMODE, FICOL_FSTATE, FICOL_FSIZE,
+    FICOL_FRDEV, FICOL_FMTIME, FICOL_FINODE, FICOL_FNLINK, FICOL_FCOLOR,
+    FICOL_DI
+};
+
+static const struct fiColumn_s {
+    const char * name;
+    enum fiColumn_e col;
+    char typecode;		/*!< 0 for string columns */
+} fiColumns[] = {
+    { "BN",	FICOL_BN,	0 },
+    { "DN",	FICOL_DN,	0 },
+    { "FN",	FICOL_FN,	0 },
+    { "FLink",	FICOL_FLINK,	0 },
+    { "FUser",	FICOL_FUSER,	0 },
+    { "FGroup",	FICOL_FGROUP,	0 },
+    { "FClass",	FICOL_FCLASS,	0 },
+    { "Digest",	FICOL_DIGEST,	0 },
+    { "FFlags",	FICOL_FFLAGS,	'I' },
+    { "VFlags",	FICOL_VFLAGS,	'I' },
+    { "FMode",	FICOL_FMODE,	'H' },
+    { "FState",	FICOL_FSTATE,	'i' },
+    { "FSize",	FICOL_FSIZE,	'L' },
+    { "FRdev",	FICOL_FRDEV,	'I' },
+    { "FMtime",	FICOL_FMTIME,	'I' },
+    { "FInode",	FICOL_FINODE,	'I' },
+    { "FNlink",	FICOL_FNLINK,	'I' },
+    { "FColor",	FICOL_FCOLOR,	'I' },
+    { "DI",	FICOL_DI,	'I' },
+    { NULL,	0,		0 }
+};
+
+static unsigned long fiNumValue(rpmfi fi, enum fiColumn_e col)
+{
+    switch (col) {
+    case FICOL_FFLAGS:	return rpmfiFFlags(fi);
+    case FICOL_VFLAGS:	return rpmfiVFlags(fi);
+    case FICOL_FMODE:	return rpmfiFMode(fi);
+    case FICOL_FSTATE:	return rpmfiFState(fi);
+    case FICOL_FSIZE:	return rpmfiFSize(fi);
+    case FICOL_FRDEV:	return rpmfiFRdev(fi);
+    case FICOL_FMTIME:	return rpmfiFMtime(fi);
+    case FICOL_FINODE:	return rpmfiFInode(fi);
+    case FICOL_FNLINK:	return rpmfiFNlink(fi);
+    case FICOL_FCOLOR:	return rpmfiFColor(fi);
+    case FICOL_DI:	return rpmfiDI(fi);
+    default:		break;
+    }
+    return 0;
+}
+
+/**
+ * Return a string value, *freeit is set if the caller must free it.
+ */
+static const char * fiStrValue(rpmfi fi, enum fiColumn_e col, int * freeit)
+{
+    *freeit = 0;
+    switch (col) {
+    case FICOL_BN:	return rpmfiBN(fi);
+    case FICOL_DN:	return rpmfiDN(fi);
+    case FICOL_FN:	return rpmfiFN(fi);
+    case FICOL_FLINK:	return rpmfiFLink(fi);
+    case FICOL_FUSER:	return rpmfiFUser(fi);
+    case FICOL_FGROUP:	return rpmfiFGroup(fi);
+    case FICOL_FCLASS:	return rpmfiFClass(fi);
+    case FICOL_DIGEST:	*freeit = 1; return rpmfiFDigestHex(fi, NULL);
+    default:		break;
+    }
+    return NULL;
+}
+
+/**
+ * Create an array.array from raw values.
+ */
+static PyObject * arrayFromBuffer(char typecode, const void * buf, size_t len)
+{
+    PyObject * mod, * arr = NULL;
+
+    if ((mod = PyImport_ImportModule("array")) != NULL) {
+	arr = PyObject_CallMethod(mod, "array", "cs#", typecode,
+				  buf, (int) len);
+	Py_DECREF(mod);
+    }
+    return arr;
+}
+
+/**
+ * Collect a numeric column into an array.array of the column's typecode.
+ */
+static PyObject * fiNumColumn(rpmfi fi, const struct fiColumn_s * c)
+{
+    PyObject * arr;
+    int i, fc = rpmfiFC(fi);
+    size_t isize;
+    char * buf;
+
+    switch (c->typecode) {
+    case 'H':	isize = sizeof(unsigned short);	break;
+    case 'L':	isize = sizeof(unsigned long);	break;
+    default:	isize = sizeof(unsigned int);	break;
+    }
+    buf = xmalloc(fc ? fc * isize : 1);
+
+    for (i = 0; i < fc; i++) {
+	unsigned long v;
+	(void) rpmfiSetFX(fi, i);
+	v = fiNumValue(fi, c->col);
+	switch (c->typecode) {
+	case 'H':	((unsigned short *) buf)[i] = v;	break;
+	case 'L':	((unsigned long *) buf)[i] = v;		break;
+	default:	((unsigned int *) buf)[i] = v;		break;
+	}
+    }
+
+    arr = arrayFromBuffer(c->typecode, buf, fc * isize);
+    free(buf);
+    return arr;
+}
+
+/**
+ * Collect a string column into a list. Runs of equal strings (files of
+ * one directory, owners, classes) share a single python string.
+ */
+static PyObject * fiStrColumn(rpmfi fi, const struct fiColumn_s * c)
+{
+    int i, fc = rpmfiFC(fi);
+    PyObject * list = PyList_New(fc);
+    PyObject * prevo = NULL;
+    char * prev = NULL;
+
+    for (i = 0; list && i < fc; i++) {
+	const char * str;
+	PyObject * o;
+	int freeit;
+
+	(void) rpmfiSetFX(fi, i);
+	str = fiStrValue(fi, c->col, &freeit);
+	if (str == NULL) {
+	    o = Py_None;
+	    Py_INCREF(o);
+	} else if (prev && !strcmp(prev, str)) {
+	    o = prevo;
+	    Py_INCREF(o);
+	} else {
+	    if ((o = PyString_FromString(str)) == NULL) {
+		Py_DECREF(list);
+		list = NULL;
+	    }
+	    free(prev);
+	    prev = (o != NULL) ? xstrdup(str) : NULL;
+	    prevo = o;
+	}
+	if (freeit)
+	    free((char *) str);
+	if (list)
+	    PyList_SET_ITEM(list, i, o);
+    }
+    free(prev);
+    return list;
+}
+
+static PyObject *
+rpmfi_Paths(rpmfiObject * s)
+{
+    PyObject * dirnames, * basenames, * dirindexes, * result = NULL;
+    int i, fc = rpmfiFC(s->fi), dc = rpmfiDC(s->fi);
+    int fx = rpmfiFX(s->fi);
+    unsigned int * dil;
+
+    if (fc < 0)
+	fc = 0;
+    if (dc < 0)
+	dc = 0;
+    dirnames = PyList_New(dc);
+    basenames = PyList_New(fc);
+    dil = xmalloc((fc ? fc : 1) * sizeof(*dil));
+    if (dirnames == NULL || basenames == NULL)
+	goto exit;
+
+    /* rpmfi has no dirname accessor by dir index, fill in from files */
+    for (i = 0; i < dc; i++) {
+	Py_INCREF(Py_None);
+	PyList_SET_ITEM(dirnames, i, Py_None);
+    }
+    for (i = 0; i < fc; i++) {
+	PyObject * o;
+	int dx;
+
+	(void) rpmfiSetFX(s->fi, i);
+	dx = rpmfiDX(s->fi);
+	dil[i] = dx;
+	if ((o = PyString_FromString(rpmfiBN(s->fi))) == NULL)
+	    break;
+	PyList_SET_ITEM(basenames, i, o);
+	if (dx >= 0 && dx < dc && PyList_GET_ITEM(dirnames, dx) == Py_None) {
+	    if ((o = PyString_FromString(rpmfiDN(s->fi))) == NULL)
+		break;
+	    PyList_SetItem(dirnames, dx, o);
+	}
+    }
+    (void) rpmfiSetFX(s->fi, fx);
+    if (i < fc)
+	goto exit;
+
+    if ((dirindexes = arrayFromBuffer('I', dil, fc * sizeof(*dil))) != NULL)
+	result = Py_BuildValue("(OON)", dirnames, basenames, dirindexes);
+
+exit:
+    Py_XDECREF(dirnames);
+    Py_XDECREF(basenames);
+    free(dil);
+    return result;
+}
+
+PyObject *
+rpmfi_JoinPaths(PyObject * self, PyObject * args, PyObject * kwds)
+{
+    PyObject * dno, * bno, * dio;
+    PyObject * dnseq = NULL, * bnseq = NULL, * diseq = NULL;
+    PyObject * result = NULL;
+    int i, n, dc;
+    char * kwlist[] = {"dirnames", "basenames", "dirindexes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO:joinPaths", kwlist,
+	    &dno, &bno, &dio))
+	return NULL;
+
+    if ((dnseq = PySequence_Fast(dno, "dirnames must be a sequence")) == NULL
+     || (bnseq = PySequence_Fast(bno, "basenames must be a sequence")) == NULL
+     || (diseq = PySequence_Fast(dio, "dirindexes must be a sequence")) == NULL)
+	goto exit;
+
+    n = PySequence_Fast_GET_SIZE(bnseq);
+    dc = PySequence_Fast_GET_SIZE(dnseq);
+    if (PySequence_Fast_GET_SIZE(diseq) != n) {
+	PyErr_SetString(PyExc_ValueError,
+			"basenames and dirindexes differ in length");
+	goto exit;
+    }
+
+    result = PyList_New(n);
+    for (i = 0; result && i < n; i++) {
+	PyObject * bn = PySequence_Fast_GET_ITEM(bnseq, i);
+	PyObject * dn;
+	PyObject * fn;
+	long dx = PyInt_AsLong(PySequence_Fast_GET_ITEM(diseq, i));
+
+	if (dx < 0 || dx >= dc) {
+	    if (!PyErr_Occurred())
+		PyErr_SetString(PyExc_IndexError, "dirindex out of range");
+	    Py_CLEAR(result);
+	    break;
+	}
+	dn = PySequence_Fast_GET_ITEM(dnseq, dx);
+	if (!PyString_Check(dn) || !PyString_Check(bn)) {
+	    PyErr_SetString(PyExc_TypeError, "strings expected");
+	    Py_CLEAR(result);
+	    break;
+	}
+	fn = PyString_FromStringAndSize(NULL,
+				PyString_GET_SIZE(dn) + PyString_GET_SIZE(bn));
+	if (fn == NULL) {
+	    Py_CLEAR(result);
+	    break;
+	}
+	memcpy(PyString_AS_STRING(fn), PyString_AS_STRING(dn),
+	       PyString_GET_SIZE(dn));
+	memcpy(PyString_AS_STRING(fn) + PyString_GET_SIZE(dn),
+	       PyString_AS_STRING(bn), PyString_GET_SIZE(bn));
+	PyList_SET_ITEM(result, i, fn);
+    }
+
+exit:
+    Py_XDECREF(dnseq);
+    Py_XDECREF(bnseq);
+    Py_XDECREF(diseq);
+    return result;
+}
+
+static PyObject *
+rpmfi_Column(rpmfiObject * s, PyObject * args, PyObject * kwds)
+{
+    const struct fiColumn_s * c;
+    PyObject * result;
+    const char * name;
+    int fx;
+    char * kwlist[] = {"name", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:Column", kwlist, &name))
+	return NULL;
+
+    for (c = fiColumns; c->name != NULL; c++) {
+	if (!strcmp(c->name, name))
+	    break;
+    }
+    if (c->name == NULL) {
+	PyErr_Format(PyExc_KeyError, "unknown column: %s", name);
+	return NULL;
+    }
+
+    /* don't disturb a running iteration */
+    fx = rpmfiFX(s->fi);
+    result = c->typecode ? fiNumColumn(s->fi, c) : fiStrColumn(s->fi, c);
+    (void) rpmfiSetFX(s->fi, fx);
+
+    return result;
+}
+
+/**
+ * Shared state of fi.verify() workers.
+ */
+struct verifyFiles_s {
+    struct fileVerify_s * files;
+    struct fileVerifyCache_s * caches;	/*!< one per worker */
+};
+
+static void verifyFile(void * data, int worker, int ix)
+{
+    struct verifyFiles_s * vf = data;
+    fileVerify(&vf->files[ix], &vf->caches[worker]);
+}
+
+static PyObject *
+rpmfi_Verify(rpmfiObject * s, PyObject * args, PyObject * kwds)
+{
+    const char * rootDir = "/";
+    unsigned int flags = RPMVERIFY_ALL;
+    int workers = 0;
+    int ghost = 0;
+    int config = 1;
+    struct verifyFiles_s vf;
+    PyObject * result = NULL;
+    rpmpool pool = NULL;
+    int i, n = 0, fc, fx;
+    char * kwlist[] = {"rootDir", "flags", "workers", "ghost", "config", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sIiii:Verify", kwlist,
+	    &rootDir, &flags, &workers, &ghost, &config))
+	return NULL;
+
+    /* Collect what is to be verified, skipping files rpm -V skips. */
+    fc = rpmfiFC(s->fi);
+    fx = rpmfiFX(s->fi);
+    memset(&vf, 0, sizeof(vf));
+    vf.files = xcalloc(fc ? fc : 1, sizeof(*vf.files));
+    for (i = 0; i < fc; i++) {
+	rpmfileAttrs fflags;
+
+	(void) rpmfiSetFX(s->fi, i);
+	switch (rpmfiFState(s->fi)) {
+	case RPMFILE_STATE_NETSHARED:
+	case RPMFILE_STATE_REPLACED:
+	case RPMFILE_STATE_NOTINSTALLED:
+	case RPMFILE_STATE_WRONGCOLOR:
+	    continue;
+	default:
+	    break;
+	}
+	fflags = rpmfiFFlags(s->fi);
+	if (((fflags & RPMFILE_GHOST) && !ghost)
+	 || ((fflags & RPMFILE_CONFIG) && !config))
+	    continue;
+	fileVerifyInit(&vf.files[n++], s->fi, rootDir, flags);
+    }
+    (void) rpmfiSetFX(s->fi, fx);
+
+    if (workers <= 0)
+	workers = rpmpoolDefaultWorkers();
+    if (workers > n)
+	workers = n;
+    if (workers < 1)
+	workers = 1;
+    vf.caches = xcalloc(workers, sizeof(*vf.caches));
+
+    debug("(%p) fi %p %d files %d workers\n", s, s->fi, n, workers);
+
+    if (n > 0 && (pool = rpmpoolNew(workers, n, verifyFile, &vf)) == NULL) {
+	PyErr_SetString(pyrpmError, "cannot start verification threads");
+	goto exit;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n; i++)
+	(void) rpmpoolWait(pool, i);
+    pool = rpmpoolFree(pool);
+    Py_END_ALLOW_THREADS
+
+    /* Only mismatches are reported. */
+    result = PyList_New(0);
+    for (i = 0; result != NULL && i < n; i++) {
+	struct fileVerify_s * fv = &vf.files[i];
+	PyObject * res;
+
+	if (fv->res == RPMVERIFY_NONE)
+	    continue;
+	(void) rpmfiSetFX(s->fi, fv->fx);
+	res = Py_BuildValue("{s:i,s:s,s:I,s:I}",
+		"fx", fv->fx,
+		"path", rpmfiFN(s->fi),
+		"result", (unsigned int) fv->res,
+		"fflags", (unsigned int) fv->fflags);
+	if (res == NULL || PyList_Append(result, res))
+	    Py_CLEAR(result);
+	Py_XDECREF(res);
+    }
+    (void) rpmfiSetFX(s->fi, fx);
+
+exit:
+    for (i = 0; i < n; i++)
+	fileVerifyFree(&vf.files[i]);
+    free(vf.files);
+    for (i = 0; vf.caches && i < workers; i++)
+	fileVerifyCacheFree(&vf.caches[i]);
+    free(vf.caches);
+
+    return result;
+}
+
+/**
+ * Path index entry, entries are sorted by dirname and basename.
+ */
+struct fiIndexEntry_s {
+    const char * dn;		/*!< borrowed from the rpmfi */
+    const char * bn;		/*!< borrowed from the rpmfi */
+    int fx;
+};
+
+static int fiIndexCmp(const void * a, const void * b)
+{
+    const struct fiIndexEntry_s * ea = a, * eb = b;
+    int rc = strcmp(ea->dn, eb->dn);
+    return rc ? rc : strcmp(ea->bn, eb->bn);
+}
+
+/**
+ * Look up a path, building the index on first use.
+ * @return		file index, -1 if not found
+ */
+static int fiFindPath(rpmfiObject * s, const char * path)
+{
+    const char * bn = strrchr(path, '/');
+    struct fiIndexEntry_s key, * e;
+    char * dn;
+    int fc = rpmfiFC(s->fi);
+
+    if (bn == NULL || fc <= 0)
+	return -1;
+
+    if (s->index == NULL) {
+	int i, fx = rpmfiFX(s->fi);
+
+	s->index = xmalloc(fc * sizeof(*s->index));
+	for (i = 0; i < fc; i++) {
+	    (void) rpmfiSetFX(s->fi, i);
+	    s->index[i].dn = rpmfiDN(s->fi);
+	    s->index[i].bn = rpmfiBN(s->fi);
+	    s->index[i].fx = i;
+	}
+	(void) rpmfiSetFX(s->fi, fx);
+	qsort(s->index, fc, sizeof(*s->index), fiIndexCmp);
+    }
+
+    /* dirnames carry their trailing slash */
+    bn++;
+    dn = xmalloc(bn - path + 1);
+    memcpy(dn, path, bn - path);
+    dn[bn - path] = '\0';
+    key.dn = dn;
+    key.bn = bn;
+    e = bsearch(&key, s->index, fc, sizeof(*s->index), fiIndexCmp);
+    free(dn);
+
+    return (e != NULL) ? e->fx : -1;
+}
+
+static PyObject *
+rpmfi_Find(rpmfiObject * s, PyObject * args, PyObject * kwds)
+{
+    const char * path;
+    char * kwlist[] = {"path", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:Find", kwlist, &path))
+	return NULL;
+
+    return Py_BuildValue("i", fiFindPath(s, path));
+}
+
 static struct PyMethodDef rpmfiFile_methods[] = {
  {"BN",		(PyCFunction)rpmfiFile_BN,	METH_NOARGS,
 	NULL},
@@ -218,6 +715,27 @@ static struct PyMethodDef rpmfi_methods[] = {
 	NULL},
  {"DX",		(PyCFunction)rpmfi_DX,		METH_NOARGS,
 	NULL},
+ {"paths",	(PyCFunction)rpmfi_Paths,	METH_NOARGS,
+"fi.paths() -> (dirnames, basenames, dirindexes)\n\
+- Return the file names as stored in the header: the list of unique\n\
+  dirnames, the list of basenames and an array.array of dirname indexes.\n\
+  Use rpm.joinPaths() or fi.column(\"FN\") for full paths.\n" },
+ {"find",	(PyCFunction)rpmfi_Find,	METH_VARARGS|METH_KEYWORDS,
+"fi.find(path) -> index\n\
+- Return the file index of a path, -1 if not found.\n" },
+ {"column",	(PyCFunction)rpmfi_Column,	METH_VARARGS|METH_KEYWORDS,
+"fi.column(name) -> array or list\n\
+- Return one attribute of all files at once. Numeric columns (FFlags,\n\
+  VFlags, FMode, FState, FSize, FRdev, FMtime, FInode, FNlink, FColor, DI)\n\
+  are array.array objects, string columns (BN, DN, FN, FLink, FUser,\n\
+  FGroup, FClass, Digest) are lists.\n" },
+ {"verify",	(PyCFunction)rpmfi_Verify,	METH_VARARGS|METH_KEYWORDS,
+"fi.verify([rootDir[, flags[, workers[, ghost[, config]]]]]) -> [{...}, ...]\n\
+- Verify the files on disk against the file info, on worker threads.\n\
+  flags limits the RPMVERIFY_* attributes checked (besides each file's\n\
+  VFlags). %ghost files are skipped unless ghost is set, %config files\n\
+  are skipped if config is not set, missing %missingok files are fine.\n\
+  Returns a dict (fx, path, result, fflags) for each mismatching file.\n" },
  {NULL,		NULL}		/* sentinel */
 };
 
@@ -227,6 +745,7 @@ static void
 rpmfi_dealloc(rpmfiObject * s)
 {
     if (s) {
+	free(s->index);
 	s->fi = rpmfiFree(s->fi);
 	PyObject_Del(s);
     }
@@ -259,6 +778,27 @@ rpmfi_subscript(rpmfiObject * s, PyObject * key)
     }
 }
 
+static int
+rpmfi_contains(rpmfiObject * s, PyObject * key)
+{
+    if (!PyString_Check(key)) {
+	PyErr_SetString(PyExc_TypeError, "string expected");
+	return -1;
+    }
+    return (fiFindPath(s, PyString_AsString(key)) >= 0);
+}
+
+static PySequenceMethods rpmfi_as_sequence = {
+        (lenfunc) rpmfi_length,		/* sq_length */
+        0,				/* sq_concat */
+        0,				/* sq_repeat */
+        0,				/* sq_item */
+        0,				/* sq_slice */
+        0,				/* sq_ass_item */
+        0,				/* sq_ass_slice */
+        (objobjproc) rpmfi_contains,	/* sq_contains */
+};
+
 static PyMappingMethods rpmfi_as_mapping = {
         (lenfunc) rpmfi_length,		/* mp_length */
         (binaryfunc) rpmfi_subscript,	/* mp_subscript */
@@ -277,6 +817,7 @@ static int rpmfi_init(rpmfiObject * s, PyObject *args, PyObject *kwds)
 static void rpmfi_free(rpmfiObject * s)
 {
     debug("%p -- fi %p\n", s, s->fi);
+    free(s->index);
     s->fi = rpmfiFree(s->fi);
 
     PyObject_Del((PyObject *)s);
@@ -301,6 +842,7 @@ static PyObject * rpmfi_new(PyTypeObject * subtype, PyObject *args, PyObject *kw
     }
     s->fi = rpmfiNew(NULL, hdrGetHeader(ho), RPMTAG_BASENAMES, flags);
     s->cur = NULL;
+    s->index = NULL;
 
     debug("%p ++ fi %p\n", s, s->fi);
 
@@ -326,7 +868,7 @@ PyTypeObject rpmfi_Type = {
 	(cmpfunc)0,			/* tp_compare */
 	(reprfunc)0,			/* tp_repr */
 	0,				/* tp_as_number */
-	0,				/* tp_as_sequence */
+	&rpmfi_as_sequence,		/* tp_as_sequence */
 	&rpmfi_as_mapping,		/* tp_as_mapping */
 	(hashfunc)0,			/* tp_hash */
 	(ternaryfunc)0,			/* tp_call */
@@ -418,5 +960,6 @@ rpmfi_Wrap(rpmfi fi)
     }
     s->fi = fi;
     s->cur = NULL;
+    s->index = NULL;
     return (PyObject *) s;
 }
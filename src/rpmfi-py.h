@@ -19,6 +19,7 @@ typedef struct rpmfiObject_s {
     PyObject *md_dict;		/*!< to look like PyModuleObject */
     rpmfiFileObject * cur;
     rpmfi fi;
+    struct fiIndexEntry_s * index;	/*!< path index, built on first lookup */
 } rpmfiObject;
 
 extern PyTypeObject rpmfi_Type;
@@ -29,4 +30,10 @@ rpmfi fiFromFi(rpmfiObject * fi);
 
 PyObject * rpmfi_Wrap(rpmfi fi);
 
+/**
+ * Join (dirnames, basenames, dirindexes) as returned by fi.paths()
+ * into a list of full paths.
+ */
+PyObject * rpmfi_JoinPaths(PyObject * self, PyObject * args, PyObject * kwds);
+
 #endif
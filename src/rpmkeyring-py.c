@@ -5,12 +5,31 @@
 #include <rpm/rpmkeyring.h>
 
 #include "rpmkeyring-py.h"
+#include "rpmvcache-py.h"
 #include "rpmdebug-py.h"
 
 /** \ingroup python
  * \class RpmKeyring
  *
  */
+/**
+ * Fingerprint a key file, keys read from it are the same while it is.
+ */
+static uint64_t pubkeyFileId(const char * fn)
+{
+    char buf[BUFSIZ];
+    uint64_t h = 0;
+    size_t nb;
+    FILE * f;
+
+    if ((f = fopen(fn, "r")) == NULL)
+	return 0;
+    while ((nb = fread(buf, 1, sizeof(buf), f)) > 0)
+	h = rpmvcacheHash(h, buf, nb);
+    fclose(f);
+    return h;
+}
+
 /** \ingroup py_c
  */
 static void rpmPubkey_dealloc(rpmPubkeyObject * self)
@@ -49,6 +68,7 @@ static PyObject *rpmPubkey_new(PyTypeObject *subtype,
 	return PyErr_NoMemory();
     }
     self->pubkey = pubkey;
+    self->keyid = pubkeyFileId(PyString_AsString(arg));
     return (PyObject *)self;
 }
 
@@ -65,6 +85,7 @@ static void rpmKeyring_dealloc(rpmKeyringObject * self)
 {
     if (self) {
 	rpmKeyringFree(self->keyring);
+	Py_XDECREF(self->keys);
 	PyObject_Del(self);
     }
 }
@@ -80,6 +101,9 @@ static PyObject *rpmKeyring_new(PyTypeObject *subtype,
     }
 
     self->keyring = rpmKeyringNew();
+    self->keys = PyList_New(0);
+    self->keyid = 0;
+    self->fromdb = 0;
     return (PyObject *)self;
 }
 
@@ -100,6 +124,11 @@ static PyObject *rpmKeyring_addKey(rpmKeyringObject *self,
     }
 
     rc = rpmKeyringAddKey(self->keyring, pubkey->pubkey);
+    /* order of addition doesn't matter, duplicates aren't added */
+    if (rc == 0) {
+	self->keyid ^= pubkey->keyid;
+	PyList_Append(self->keys, (PyObject *) pubkey);
+    }
     return PyInt_FromLong(rc);
 };
 
@@ -214,6 +243,10 @@ PyObject * rpmKeyring_Wrap(rpmKeyring keyring)
 	return PyErr_NoMemory();
     }
     ko->keyring = keyring;
+    ko->keys = PyList_New(0);
+    /* XXX only ts.getKeyring() wraps keyrings, loaded from the rpmdb */
+    ko->keyid = 0;
+    ko->fromdb = 1;
     return (PyObject*) ko;
 }
 
@@ -2,6 +2,7 @@
 #define _RPMKEYRING_PY_H
 
 #include <Python.h>
+#include <stdint.h>
 #include <rpm/rpmtypes.h>
 
 /** \ingroup py_c
@@ -19,11 +20,15 @@ struct rpmPubkeyObject_s {
     PyObject_HEAD
     PyObject *md_dict;		/*!< to look like PyModuleObject */
     rpmPubkey pubkey;
+    uint64_t keyid;		/*!< fingerprint of the key file contents */
 };
 struct rpmKeyringObject_s {
     PyObject_HEAD
     PyObject *md_dict;		/*!< to look like PyModuleObject */
     rpmKeyring keyring;
+    PyObject * keys;		/*!< rpm.pubkey objects added */
+    uint64_t keyid;		/*!< fingerprint of the keys added */
+    int fromdb;			/*!< holds the rpmdb gpg-pubkeys too? */
 };
 
 extern PyTypeObject rpmKeyring_Type;
@@ -2,9 +2,13 @@
  * \file python/rpmmi-py.c
  */
 
+#include <pthread.h>
+
+#include <rpm/rpmlib.h>	/* headerCheck */
 #include <rpm/rpmdb.h>
 
 #include "rpmmi-py.h"
+#include "rpmts-py.h"
 #include "header-py.h"
 #include "rpmdebug-py.h"
 
@@ -23,6 +27,11 @@
  *
  * - pattern(tag,mire,pattern) 	Specify secondary match criteria.
  *
+ * - sorted(tag,reverse,limit)	Return headers sorted by tag value.
+ *
+ * - prefetch(depth)		Read ahead up to depth headers in a
+ *				background thread.
+ *
  * To obtain a rpm.mi object to query the database used by a transaction,
  * the ts.match(tag,key,len) method is used.
  *
@@ -61,6 +70,123 @@
  * \name Class: Rpmmi
  */
 
+/** \ingroup py_c
+ * Prefetched header and its database instance.
+ */
+struct prefetchItem_s {
+    Header h;
+    unsigned int offset;
+};
+
+/** \ingroup py_c
+ * Single producer, single consumer ring of prefetched headers.
+ */
+struct rpmmiPrefetch_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;	/*!< signaled on every ring state change */
+    rpmts ts;			/*!< private, for header checks of mi */
+    rpmdb db;			/*!< pooled handle checked out for mi */
+    rpmdbMatchIterator mi;
+    int count;			/*!< match count of mi */
+    int depth;			/*!< ring size */
+    int head;			/*!< index of oldest item */
+    int nitems;			/*!< no. of items in ring */
+    int done;			/*!< producer has exhausted mi */
+    int stop;			/*!< consumer wants producer to quit */
+    struct prefetchItem_s * ring;
+};
+
+/**
+ * Producer thread: advance the iterator until the ring is full.
+ */
+static void * prefetchThread(void * arg)
+{
+    rpmmiPrefetch pf = arg;
+    struct prefetchItem_s item;
+
+    pthread_mutex_lock(&pf->lock);
+    while (!pf->stop) {
+	if (pf->nitems == pf->depth) {
+	    pthread_cond_wait(&pf->cond, &pf->lock);
+	    continue;
+	}
+	pthread_mutex_unlock(&pf->lock);
+
+	/* headers returned by the iterator only live until the next call */
+	if ((item.h = rpmdbNextIterator(pf->mi)) != NULL) {
+	    item.h = headerLink(item.h);
+	    item.offset = rpmdbGetIteratorOffset(pf->mi);
+	}
+
+	pthread_mutex_lock(&pf->lock);
+	if (item.h == NULL)
+	    break;
+	pf->ring[(pf->head + pf->nitems) % pf->depth] = item;
+	pf->nitems++;
+	pthread_cond_broadcast(&pf->cond);
+    }
+    pf->done = 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->lock);
+
+    return NULL;
+}
+
+/**
+ * Pop the next prefetched item, waiting for the producer if necessary.
+ * @return		0 on success, -1 when the producer is done
+ */
+static int prefetchPop(rpmmiPrefetch pf, struct prefetchItem_s * item)
+{
+    int rc = -1;
+
+    pthread_mutex_lock(&pf->lock);
+    while (pf->nitems == 0 && !pf->done)
+	pthread_cond_wait(&pf->cond, &pf->lock);
+    if (pf->nitems > 0) {
+	*item = pf->ring[pf->head];
+	pf->head = (pf->head + 1) % pf->depth;
+	pf->nitems--;
+	pthread_cond_broadcast(&pf->cond);
+	rc = 0;
+    }
+    pthread_mutex_unlock(&pf->lock);
+
+    return rc;
+}
+
+/**
+ * Stop the producer and free all prefetch resources, including the
+ * iterator.
+ */
+static rpmmiPrefetch prefetchFree(rpmmiPrefetch pf)
+{
+    if (pf == NULL)
+	return NULL;
+
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = 1;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->lock);
+    pthread_join(pf->thread, NULL);
+
+    while (pf->nitems > 0) {
+	headerFree(pf->ring[pf->head].h);
+	pf->head = (pf->head + 1) % pf->depth;
+	pf->nitems--;
+    }
+    pf->mi = rpmdbFreeIterator(pf->mi);
+    pf->db = rpmdbPoolRelease(pf->db);
+    pf->ts = rpmtsFree(pf->ts);
+    pthread_cond_destroy(&pf->cond);
+    pthread_mutex_destroy(&pf->lock);
+    free(pf->ring);
+    free(pf);
+
+    return NULL;
+}
+
 /**
  */
 static PyObject *
@@ -68,10 +194,30 @@ rpmmi_iternext(rpmmiObject * s)
 {
     Header h;
 
+    if (s->pf != NULL) {
+	struct prefetchItem_s item;
+	PyObject * ho;
+	int rc;
+
+	Py_BEGIN_ALLOW_THREADS
+	rc = prefetchPop(s->pf, &item);
+	if (rc)
+	    s->pf = prefetchFree(s->pf);
+	Py_END_ALLOW_THREADS
+
+	if (rc)
+	    return NULL;
+	s->offset = item.offset;
+	ho = hdr_Wrap(item.h);
+	headerFree(item.h);	/* XXX ref held by ho */
+	return ho;
+    }
+
     if (s->mi == NULL || (h = rpmdbNextIterator(s->mi)) == NULL) {
 	s->mi = rpmdbFreeIterator(s->mi);
 	return NULL;
     }
+    s->nread++;
     return hdr_Wrap(h);
 }
 
@@ -82,7 +228,9 @@ rpmmi_Instance(rpmmiObject * s)
 {
     int rc = 0;
 
-    if (s->mi != NULL)
+    if (s->pf != NULL)
+	rc = s->offset;
+    else if (s->mi != NULL)
 	rc = rpmdbGetIteratorOffset(s->mi);
 
     return Py_BuildValue("i", rc);
@@ -95,7 +243,9 @@ rpmmi_Count(rpmmiObject * s)
 {
     int rc = 0;
 
-    if (s->mi != NULL)
+    if (s->pf != NULL)
+	rc = s->pf->count;
+    else if (s->mi != NULL)
 	rc = rpmdbGetIteratorCount(s->mi);
 
     return Py_BuildValue("i", rc);
@@ -120,8 +270,360 @@ rpmmi_Pattern(rpmmiObject * s, PyObject * args, PyObject * kwds)
 	return NULL;
     }
 
+    if (s->pf != NULL) {
+	PyErr_SetString(pyrpmError, "match iterator is prefetching");
+	return NULL;
+    }
+
+    if (s->mi == NULL) {
+	Py_RETURN_NONE;
+    }
     rpmdbSetIteratorRE(s->mi, tag, type, pattern);
 
+    s->patterns = xrealloc(s->patterns,
+			   (s->npatterns + 1) * sizeof(*s->patterns));
+    s->patterns[s->npatterns].tag = tag;
+    s->patterns[s->npatterns].type = type;
+    s->patterns[s->npatterns].pattern = xstrdup(pattern);
+    s->npatterns++;
+
+    Py_RETURN_NONE;
+}
+
+/** \ingroup py_c
+ * Sort key and database instance of a matched header.
+ */
+struct sortItem_s {
+    uint64_t num;
+    char * str;
+    unsigned int offset;
+};
+
+/** \ingroup py_c
+ */
+struct sortCtx_s {
+    int isString;
+    int reverse;
+};
+
+/**
+ * Compare two sort items.
+ * @return		< 0 if a sorts before b, > 0 if after
+ */
+static int sortItemCmp(const struct sortItem_s * a, const struct sortItem_s * b,
+			const struct sortCtx_s * ctx)
+{
+    int rc = 0;
+
+    if (ctx->isString) {
+	if (a->str && b->str)
+	    rc = strcmp(a->str, b->str);
+	else
+	    rc = (a->str != NULL) - (b->str != NULL);
+    } else if (a->num != b->num) {
+	rc = (a->num < b->num) ? -1 : 1;
+    }
+    if (ctx->reverse)
+	rc = -rc;
+    /* keep order of equal keys stable wrt. database order */
+    if (rc == 0 && a->offset != b->offset)
+	rc = (a->offset < b->offset) ? -1 : 1;
+    return rc;
+}
+
+/**
+ * Restore heap property below node i, the item sorting last is at the root.
+ */
+static void sortSiftDown(struct sortItem_s * items, int i, int n,
+			 const struct sortCtx_s * ctx)
+{
+    struct sortItem_s tmp;
+    int c;
+
+    while ((c = 2 * i + 1) < n) {
+	if (c + 1 < n && sortItemCmp(&items[c+1], &items[c], ctx) > 0)
+	    c++;
+	if (sortItemCmp(&items[c], &items[i], ctx) <= 0)
+	    break;
+	tmp = items[i];
+	items[i] = items[c];
+	items[c] = tmp;
+	i = c;
+    }
+}
+
+static void sortHeapify(struct sortItem_s * items, int n,
+			const struct sortCtx_s * ctx)
+{
+    int i;
+    for (i = n / 2 - 1; i >= 0; i--)
+	sortSiftDown(items, i, n, ctx);
+}
+
+/**
+ * Collect (sortkey, instance) pairs from the iterator, keeping at most
+ * limit best items in a heap, and heapsort the survivors.
+ * @retval *nitems	no. of items returned
+ * @return		sorted items (malloced)
+ */
+static struct sortItem_s * sortCollect(rpmdbMatchIterator mi, rpmTag tag,
+			int limit, const struct sortCtx_s * ctx, int * nitems)
+{
+    struct sortItem_s * items = NULL;
+    struct sortItem_s item;
+    int nalloced = 0, n = 0, isHeap = 0;
+    int i;
+    rpmtd td = rpmtdNew();
+    Header h;
+
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	memset(&item, 0, sizeof(item));
+	item.offset = rpmdbGetIteratorOffset(mi);
+	if (headerGet(h, tag, td, HEADERGET_MINMEM)) {
+	    if (ctx->isString) {
+		const char * str = rpmtdGetString(td);
+		item.str = str ? xstrdup(str) : NULL;
+	    } else {
+		item.num = rpmtdGetNumber(td);
+	    }
+	    rpmtdFreeData(td);
+	}
+
+	if (limit > 0 && n == limit) {
+	    /* full: replace the current worst item if this one is better */
+	    if (!isHeap) {
+		sortHeapify(items, n, ctx);
+		isHeap = 1;
+	    }
+	    if (sortItemCmp(&item, &items[0], ctx) < 0) {
+		free(items[0].str);
+		items[0] = item;
+		sortSiftDown(items, 0, n, ctx);
+	    } else {
+		free(item.str);
+	    }
+	    continue;
+	}
+
+	if (n == nalloced) {
+	    nalloced = nalloced ? 2 * nalloced : 64;
+	    if (limit > 0 && nalloced > limit)
+		nalloced = limit;
+	    items = xrealloc(items, nalloced * sizeof(*items));
+	}
+	items[n++] = item;
+    }
+    rpmtdFree(td);
+
+    /* heapsort, worst item at the root ends up last */
+    if (!isHeap)
+	sortHeapify(items, n, ctx);
+    for (i = n - 1; i > 0; i--) {
+	item = items[0];
+	items[0] = items[i];
+	items[i] = item;
+	sortSiftDown(items, 0, i, ctx);
+    }
+
+    *nitems = n;
+    return items;
+}
+
+/**
+ */
+static PyObject *
+rpmmi_Sorted(rpmmiObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject *TagN = NULL;
+    PyObject *Limit = Py_None;
+    PyObject *list, *ho;
+    struct sortItem_s * items = NULL;
+    struct sortCtx_s ctx = { 0, 0 };
+    Header * hdrs;
+    int limit = 0;
+    int i, n = 0;
+    rpmTag tag;
+    rpmts ts;
+    char * kwlist[] = {"tag", "reverse", "limit", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iO:Sorted", kwlist,
+	    &TagN, &ctx.reverse, &Limit))
+	return NULL;
+
+    /* the producer owns the remaining matches, s->mi is gone */
+    if (s->pf != NULL) {
+	PyErr_SetString(pyrpmError, "sorted() is not supported on a prefetching match iterator");
+	return NULL;
+    }
+
+    if ((tag = tagNumFromPyObject (TagN)) == RPMTAG_NOT_FOUND) {
+	return NULL;
+    }
+
+    if (Limit != Py_None) {
+	if (!PyInt_Check(Limit) || (limit = PyInt_AsLong(Limit)) < 0) {
+	    PyErr_SetString(PyExc_ValueError, "limit must be None or a non-negative integer");
+	    return NULL;
+	}
+	if (limit == 0)
+	    return PyList_New(0);
+    }
+
+    /* headers are reloaded by instance, which needs the originating ts */
+    if (!PyObject_TypeCheck(s->ref, &rpmts_Type)) {
+	PyErr_SetString(PyExc_TypeError, "match iterator not bound to a transaction set");
+	return NULL;
+    }
+    ts = ((rpmtsObject *) s->ref)->ts;
+
+    switch (rpmTagGetType(tag) & RPM_MASK_TYPE) {
+    case RPM_STRING_TYPE:
+    case RPM_STRING_ARRAY_TYPE:
+    case RPM_I18NSTRING_TYPE:
+	ctx.isString = 1;
+	break;
+    default:
+	break;
+    }
+
+    if (s->mi == NULL)
+	return PyList_New(0);
+
+    Py_BEGIN_ALLOW_THREADS
+    items = sortCollect(s->mi, tag, limit, &ctx, &n);
+    s->mi = rpmdbFreeIterator(s->mi);
+
+    /* only now load the selected headers */
+    hdrs = xcalloc(n ? n : 1, sizeof(*hdrs));
+    for (i = 0; i < n; i++) {
+	rpmdbMatchIterator hmi;
+	Header h;
+
+	hmi = rpmtsInitIterator(ts, RPMDBI_PACKAGES,
+				&items[i].offset, sizeof(items[i].offset));
+	if ((h = rpmdbNextIterator(hmi)) != NULL)
+	    hdrs[i] = headerLink(h);
+	hmi = rpmdbFreeIterator(hmi);
+	free(items[i].str);
+    }
+    free(items);
+    Py_END_ALLOW_THREADS
+
+    list = PyList_New(0);
+    for (i = 0; i < n; i++) {
+	if (hdrs[i] == NULL)
+	    continue;
+	ho = hdr_Wrap(hdrs[i]);
+	hdrs[i] = headerFree(hdrs[i]);	/* XXX ref held by ho */
+	if (ho == NULL || PyList_Append(list, ho)) {
+	    Py_XDECREF(ho);
+	    Py_DECREF(list);
+	    list = NULL;
+	    break;
+	}
+	Py_DECREF(ho);
+    }
+    for (; i < n; i++)
+	headerFree(hdrs[i]);
+    free(hdrs);
+
+    return list;
+}
+
+/**
+ */
+static PyObject *
+rpmmi_Prefetch(rpmmiObject * s, PyObject * args, PyObject * kwds)
+{
+    rpmmiPrefetch pf;
+    rpmdbMatchIterator mi = NULL;
+    rpmdb db;
+    rpmts ts, pts;
+    int depth;
+    int i;
+    char * kwlist[] = {"depth", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i:Prefetch", kwlist, &depth))
+	return NULL;
+
+    if (depth <= 0) {
+	PyErr_SetString(PyExc_ValueError, "depth must be positive");
+	return NULL;
+    }
+    if (s->pf != NULL) {
+	PyErr_SetString(pyrpmError, "match iterator is already prefetching");
+	return NULL;
+    }
+    if (s->mi == NULL) {
+	Py_RETURN_NONE;
+    }
+    if (!PyObject_TypeCheck(s->ref, &rpmts_Type)) {
+	PyErr_SetString(PyExc_TypeError, "match iterator not bound to a transaction set");
+	return NULL;
+    }
+    ts = ((rpmtsObject *) s->ref)->ts;
+
+    /*
+     * The producer must not share the rpmdb handle of the ts: it is not
+     * thread safe and ts.closeDB() could close it under the thread. The
+     * query is replayed on a handle checked out of the pool instead, and
+     * resumes after the headers already returned. Headers are checked
+     * through a private ts, with a keyring of its own.
+     */
+    pts = rpmtsCreate();
+    (void) rpmtsSetRootDir(pts, rpmtsRootDir(ts));
+    (void) rpmtsSetVSFlags(pts, rpmtsVSFlags(ts));
+    if (!(rpmtsVSFlags(ts) & RPMVSF_NOHDRCHK))
+	rpmtsCopyKeyring((rpmtsObject *) s->ref, pts);
+
+    Py_BEGIN_ALLOW_THREADS
+    if ((db = rpmdbPoolAcquire(rpmtsRootDir(ts))) != NULL)
+	mi = rpmdbInitIterator(db, s->tag, s->key, s->keylen);
+    if (mi && !(rpmtsVSFlags(ts) & RPMVSF_NOHDRCHK))
+	(void) rpmdbSetHdrChk(mi, pts, headerCheck);
+    for (i = 0; mi != NULL && i < s->npatterns; i++)
+	(void) rpmdbSetIteratorRE(mi, s->patterns[i].tag,
+			s->patterns[i].type, s->patterns[i].pattern);
+    for (i = 0; mi != NULL && i < s->nread; i++) {
+	if (rpmdbNextIterator(mi) == NULL)
+	    break;
+    }
+    Py_END_ALLOW_THREADS
+
+    if (mi == NULL) {
+	db = rpmdbPoolRelease(db);
+	pts = rpmtsFree(pts);
+	PyErr_SetString(pyrpmError, "failed to open rpmdb for prefetch");
+	return NULL;
+    }
+
+    pf = xcalloc(1, sizeof(*pf));
+    pf->ring = xcalloc(depth, sizeof(*pf->ring));
+    pf->depth = depth;
+    pf->ts = pts;
+    pf->db = db;
+    pf->mi = mi;
+    pf->count = rpmdbGetIteratorCount(s->mi);
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->cond, NULL);
+
+    if (pthread_create(&pf->thread, NULL, prefetchThread, pf) != 0) {
+	pf->mi = rpmdbFreeIterator(pf->mi);
+	pf->db = rpmdbPoolRelease(pf->db);
+	pf->ts = rpmtsFree(pf->ts);
+	pthread_cond_destroy(&pf->cond);
+	pthread_mutex_destroy(&pf->lock);
+	free(pf->ring);
+	free(pf);
+	PyErr_SetString(pyrpmError, "failed to start prefetch thread");
+	return NULL;
+    }
+
+    /* the producer continues where the ts iterator was */
+    s->mi = rpmdbFreeIterator(s->mi);
+    s->offset = 0;
+    s->pf = pf;
+
     Py_RETURN_NONE;
 }
 
@@ -135,6 +637,19 @@ static struct PyMethodDef rpmmi_methods[] = {
     {"pattern",	    (PyCFunction) rpmmi_Pattern,	METH_VARARGS|METH_KEYWORDS,
 "mi.pattern(TagN, mire_type, pattern)\n\
 - Set a secondary match pattern on tags from retrieved header.\n" },
+    {"sorted",	    (PyCFunction) rpmmi_Sorted,		METH_VARARGS|METH_KEYWORDS,
+"mi.sorted(TagN, reverse=False, limit=None) -> [hdr, ...]\n\
+- Return the remaining matches sorted on TagN value. Only sort keys\n\
+  and instances are collected while iterating, with limit only the\n\
+  selected headers are loaded. The iterator is exhausted afterwards.\n\
+  Raises rpm.error once prefetch() has been called.\n" },
+    {"prefetch",    (PyCFunction) rpmmi_Prefetch,	METH_VARARGS|METH_KEYWORDS,
+"mi.prefetch(depth)\n\
+- Advance the iterator in a background thread, keeping up to depth\n\
+  decoded headers queued for iteration. The thread reads through a\n\
+  read-only database handle checked out of the shared pool (see\n\
+  rpm.flushDBPool()), the transaction set's one is left alone.\n\
+  No further patterns may be set, nor sorted() be used.\n" },
     {NULL,		NULL}		/* sentinel */
 };
 
@@ -143,7 +658,16 @@ static struct PyMethodDef rpmmi_methods[] = {
 static void rpmmi_dealloc(rpmmiObject * s)
 {
     if (s) {
+	if (s->pf) {
+	    Py_BEGIN_ALLOW_THREADS
+	    s->pf = prefetchFree(s->pf);
+	    Py_END_ALLOW_THREADS
+	}
 	s->mi = rpmdbFreeIterator(s->mi);
+	while (s->npatterns > 0)
+	    free(s->patterns[--s->npatterns].pattern);
+	free(s->patterns);
+	free(s->key);
 	Py_DECREF(s->ref);
 	PyObject_Del(s);
     }
@@ -200,7 +724,8 @@ PyTypeObject rpmmi_Type = {
 	0,				/* tp_is_gc */
 };
 
-PyObject * rpmmi_Wrap(rpmdbMatchIterator mi, PyObject *s)
+PyObject * rpmmi_Wrap(rpmdbMatchIterator mi, PyObject *s,
+		rpmTag tag, const void * key, size_t keylen)
 {
     rpmmiObject * mio = (rpmmiObject *) PyObject_New(rpmmiObject, &rpmmi_Type);
 
@@ -208,6 +733,18 @@ PyObject * rpmmi_Wrap(rpmdbMatchIterator mi, PyObject *s)
 	return PyErr_NoMemory();
     }
     mio->mi = mi;
+    mio->pf = NULL;
+    mio->offset = 0;
+    mio->tag = tag;
+    mio->key = NULL;
+    mio->keylen = keylen;
+    if (key != NULL) {
+	size_t len = keylen ? keylen : strlen(key) + 1;
+	mio->key = memcpy(xmalloc(len), key, len);
+    }
+    mio->patterns = NULL;
+    mio->npatterns = 0;
+    mio->nread = 0;
     mio->ref = s;
     Py_INCREF(mio->ref);
     return (PyObject*) mio;
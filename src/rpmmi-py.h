@@ -11,6 +11,19 @@
  */
 typedef struct rpmmiObject_s rpmmiObject;
 
+/** \ingroup py_c
+ */
+typedef struct rpmmiPrefetch_s * rpmmiPrefetch;
+
+/** \ingroup py_c
+ * Secondary match pattern, kept to replay the query.
+ */
+struct rpmmiPattern_s {
+    rpmTag tag;
+    int type;
+    char * pattern;
+};
+
 /** \ingroup py_c
  */
 struct rpmmiObject_s {
@@ -18,10 +31,27 @@ struct rpmmiObject_s {
     PyObject *md_dict;		/*!< to look like PyModuleObject */
     PyObject *ref;		/* for db/ts refcounting */
     rpmdbMatchIterator mi;
+    rpmmiPrefetch pf;		/*!< background reader on a private rpmdb */
+    unsigned int offset;	/*!< instance of last prefetched header */
+    rpmTag tag;			/*!< query of mi, replayed by prefetch() */
+    char * key;
+    size_t keylen;
+    struct rpmmiPattern_s * patterns;
+    int npatterns;
+    int nread;			/*!< no. of headers returned from mi */
 } ;
 
 extern PyTypeObject rpmmi_Type;
 
-PyObject * rpmmi_Wrap(rpmdbMatchIterator mi, PyObject *s);
+/** \ingroup py_c
+ * Wrap a match iterator.
+ * @param mi		iterator
+ * @param s		object owning the database (a rpm.ts)
+ * @param tag		query tag of mi
+ * @param key		query key of mi (or NULL)
+ * @param keylen	query key length (0 for strlen)
+ */
+PyObject * rpmmi_Wrap(rpmdbMatchIterator mi, PyObject *s,
+		rpmTag tag, const void * key, size_t keylen);
 
 #endif
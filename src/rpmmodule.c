@@ -19,9 +19,14 @@
 #include "rpmte-py.h"
 #include "rpmtd-py.h"
 #include "rpmts-py.h"
+#include "rpmsnapshot-py.h"
+#include "rpmconflict-py.h"
+#include "rpmdu-py.h"
+#include "rpmprovides-py.h"
 #include "rpmlog-py.h"
 #include "rpmkeyring-py.h"
 #include "rpmfd-py.h"
+#include "rpmdbpool-py.h"
 #include "rpmdebug-py.h"
 
 /** \ingroup python
@@ -120,11 +125,19 @@ static PyObject * setStats (PyObject * self, PyObject * args, PyObject * kwds)
     return (PyObject *) Py_None;
 }
 
+/**
+ */
+static PyObject * flushDBPool (PyObject * self)
+{
+    rpmdbPoolFlush();
+    Py_RETURN_NONE;
+}
+
 /**
  */
 static PyMethodDef rpmModuleMethods[] = {
     { "TransactionSet", (PyCFunction) rpmts_Create, METH_VARARGS|METH_KEYWORDS,
-"rpm.TransactionSet([rootDir, [db]]) -> ts\n\
+"rpm.TransactionSet([rootDir, [db, [sharedDB]]]) -> ts\n\
 - Create a transaction set.\n" },
 
     { "addMacro", (PyCFunction) rpmmacro_AddMacro, METH_VARARGS|METH_KEYWORDS,
@@ -158,6 +171,26 @@ static PyMethodDef rpmModuleMethods[] = {
 	NULL },
     { "setStats", (PyCFunction) setStats, METH_VARARGS|METH_KEYWORDS,
 	NULL },
+    { "fileConflicts", (PyCFunction) rpmFileConflicts, METH_VARARGS|METH_KEYWORDS,
+"rpm.fileConflicts(headers[, ts][, installonly]) -> [{...}, ...]\n\
+- Find file conflicts between headers and, given a transaction set, with\n\
+  its installed packages. Installed packages a header upgrades (same name\n\
+  and compatible color, as rpm decides) are left out, except for names in\n\
+  installonly (such as yum's installonlypkgs, none by default). Paths are\n\
+  compared by directory fingerprint, so symlinked directories alias, as\n\
+  with rpm. Returns a dict (path, pkg, pkgNEVRA, altPkg, altInstance,\n\
+  altNEVRA) per conflict, pkg and altPkg being indexes into headers.\n" },
+    { "diskUsage", (PyCFunction) rpmDiskUsage, METH_VARARGS|METH_KEYWORDS,
+"rpm.diskUsage(headers[, rootDir]) -> {mountpoint: {...}, ...}\n\
+- Return the disk space and inodes needed to install headers, per\n\
+  filesystem, as ts.diskUsage() does.\n" },
+    { "joinPaths", (PyCFunction) rpmfi_JoinPaths, METH_VARARGS|METH_KEYWORDS,
+"rpm.joinPaths(dirnames, basenames, dirindexes) -> [path, ...]\n\
+- Join file names as returned by fi.paths() into full paths.\n" },
+    { "flushDBPool", (PyCFunction) flushDBPool, METH_NOARGS,
+"rpm.flushDBPool() -> None\n\
+- Close the shared read-only rpmdb handles (of all threads) not in use\n\
+  by any iterator. No other thread may be querying them meanwhile.\n" },
     { NULL }
 } ;
 
@@ -166,6 +199,7 @@ static PyMethodDef rpmModuleMethods[] = {
 */
 static void rpm_exithook(void)
 {
+   rpmdbPoolFlush();
    rpmdbCheckTerminate(1);
 }
 
@@ -214,8 +248,11 @@ void init_rpmng(void)
     if (PyType_Ready(&rpmfi_Type) < 0) return;
     if (PyType_Ready(&rpmmi_Type) < 0) return;
     if (PyType_Ready(&rpmps_Type) < 0) return;
+    if (PyType_Ready(&rpmProblem_Type) < 0) return;
     if (PyType_Ready(&rpmte_Type) < 0) return;
     if (PyType_Ready(&rpmts_Type) < 0) return;
+    if (PyType_Ready(&rpmsnapshot_Type) < 0) return;
+    if (PyType_Ready(&rpmProvidesIndex_Type) < 0) return;
     if (PyType_Ready(&rpmtd_Type) < 0) return;
     if (PyType_Ready(&rpmlog_Type) < 0) return;
     if (PyType_Ready(&rpmKeyring_Type) < 0) return;
@@ -256,12 +293,21 @@ void init_rpmng(void)
     Py_INCREF(&rpmps_Type);
     PyModule_AddObject(m, "ps", (PyObject *) &rpmps_Type);
 
+    Py_INCREF(&rpmProblem_Type);
+    PyModule_AddObject(m, "prob", (PyObject *) &rpmProblem_Type);
+
     Py_INCREF(&rpmte_Type);
     PyModule_AddObject(m, "te", (PyObject *) &rpmte_Type);
 
     Py_INCREF(&rpmts_Type);
     PyModule_AddObject(m, "ts", (PyObject *) &rpmts_Type);
 
+    Py_INCREF(&rpmsnapshot_Type);
+    PyModule_AddObject(m, "snapshot", (PyObject *) &rpmsnapshot_Type);
+
+    Py_INCREF(&rpmProvidesIndex_Type);
+    PyModule_AddObject(m, "ProvidesIndex", (PyObject *) &rpmProvidesIndex_Type);
+
     Py_INCREF(&rpmtd_Type);
     PyModule_AddObject(m, "td", (PyObject *) &rpmtd_Type);
 
@@ -299,6 +345,21 @@ void init_rpmng(void)
     REGISTER_ENUM(RPMFILE_UNPATCHED);
     REGISTER_ENUM(RPMFILE_PUBKEY);
 
+    REGISTER_ENUM(RPMVERIFY_NONE);
+    REGISTER_ENUM(RPMVERIFY_FILEDIGEST);
+    REGISTER_ENUM(RPMVERIFY_FILESIZE);
+    REGISTER_ENUM(RPMVERIFY_LINKTO);
+    REGISTER_ENUM(RPMVERIFY_USER);
+    REGISTER_ENUM(RPMVERIFY_GROUP);
+    REGISTER_ENUM(RPMVERIFY_MTIME);
+    REGISTER_ENUM(RPMVERIFY_MODE);
+    REGISTER_ENUM(RPMVERIFY_RDEV);
+    REGISTER_ENUM(RPMVERIFY_CAPS);
+    REGISTER_ENUM(RPMVERIFY_READLINKFAIL);
+    REGISTER_ENUM(RPMVERIFY_READFAIL);
+    REGISTER_ENUM(RPMVERIFY_LSTATFAIL);
+    REGISTER_ENUM(RPMVERIFY_ALL);
+
     REGISTER_ENUM(RPMDEP_SENSE_REQUIRES);
     REGISTER_ENUM(RPMDEP_SENSE_CONFLICTS);
 
@@ -407,6 +468,12 @@ void init_rpmng(void)
     REGISTER_ENUM(RPMMIRE_REGEX);
     REGISTER_ENUM(RPMMIRE_GLOB);
 
+    REGISTER_ENUM(RPMRC_OK);
+    REGISTER_ENUM(RPMRC_NOTFOUND);
+    REGISTER_ENUM(RPMRC_FAIL);
+    REGISTER_ENUM(RPMRC_NOTTRUSTED);
+    REGISTER_ENUM(RPMRC_NOKEY);
+
     REGISTER_ENUM(RPMVSF_DEFAULT);
     REGISTER_ENUM(RPMVSF_NOHDRCHK);
     REGISTER_ENUM(RPMVSF_NEEDPAYLOAD);
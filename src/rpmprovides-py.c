@@ -0,0 +1,423 @@
+/** \ingroup py_c
+ * \file python/rpmprovides-py.c
+ */
+
+#include <rpm/rpmdb.h>
+#include <rpm/rpmds.h>
+#include <rpm/rpmfi.h>
+#include <rpm/rpmstring.h>
+
+#include "header-py.h"
+#include "rpmds-py.h"
+#include "rpmmi-py.h"
+#include "rpmprovides-py.h"
+#include "strpool-py.h"
+#include "rpmdebug-py.h"
+
+/** \ingroup python
+ * \class Rpmprovidesindex
+ * \brief A python rpm.ProvidesIndex object maps capabilities to the
+ *	packages providing them.
+ *
+ * The index is built once from a sequence of headers (packages are
+ * identified by their position) or from an rpm.mi (packages are
+ * identified by their rpmdb instance):
+ * \code
+ *	idx = rpm.ProvidesIndex(hdrs)
+ *	idx.satisfies(("libfoo.so.1", 0, ""))	-> [0, 7]
+ *	idx.resolve(list_of_requires)		-> [[0, 7], [], ...]
+ * \endcode
+ * Dependencies are given as rpm.ds objects (current entry), (N, Flags,
+ * EVR) tuples or plain names. EVR ranges are checked natively, the EVRs
+ * of the provides are parsed once when the index is built.
+ */
+
+/**
+ * A provide: capability name, EVR (0 if none), flags and package id.
+ */
+struct provEntry_s {
+    unsigned int name;
+    unsigned int evr;
+    unsigned int pkg;
+    rpmsenseFlags flags;
+};
+
+/**
+ * Provides sorted by name and package, start[name] .. start[name + 1]
+ * being the entries of a name.
+ */
+struct provIndex_s {
+    strpool pool;		/*!< names and EVRs */
+    struct provEntry_s * entries;
+    int n;
+    int nalloced;
+    unsigned int * start;
+    struct dsEVR_s * evrs;	/*!< split EVRs, by string id */
+    int npkgs;
+};
+
+/**
+ * A dependency to resolve, copied out of python objects.
+ */
+struct provQuery_s {
+    char * N;
+    rpmsenseFlags flags;
+    struct dsEVR_s evr;
+    int nopromote;
+    unsigned int * pkgs;	/*!< result */
+    int npkgs;
+};
+
+static void provAdd(struct provIndex_s * idx, const char * N,
+		const char * EVR, rpmsenseFlags flags, unsigned int pkg)
+{
+    struct provEntry_s * e;
+
+    if (idx->n == idx->nalloced) {
+	idx->nalloced = idx->nalloced ? 2 * idx->nalloced : 4096;
+	idx->entries = xrealloc(idx->entries,
+				idx->nalloced * sizeof(*idx->entries));
+    }
+    e = idx->entries + idx->n++;
+    e->name = strpoolId(idx->pool, N, 1);
+    e->evr = (EVR && *EVR) ? strpoolId(idx->pool, EVR, 1) : 0;
+    e->pkg = pkg;
+    e->flags = flags;
+}
+
+static void provAddHeader(struct provIndex_s * idx, Header h,
+		unsigned int pkg, int files)
+{
+    rpmds ds = rpmdsInit(rpmdsNew(h, RPMTAG_PROVIDENAME, 0));
+
+    while (rpmdsNext(ds) >= 0)
+	provAdd(idx, rpmdsN(ds), rpmdsEVR(ds), rpmdsFlags(ds), pkg);
+    ds = rpmdsFree(ds);
+
+    if (files) {
+	rpmfi fi = rpmfiInit(rpmfiNew(NULL, h, RPMTAG_BASENAMES, 0), 0);
+	while (rpmfiNext(fi) >= 0)
+	    provAdd(idx, rpmfiFN(fi), NULL, RPMSENSE_ANY, pkg);
+	fi = rpmfiFree(fi);
+    }
+    idx->npkgs++;
+}
+
+static int provEntryCmp(const void * a, const void * b)
+{
+    const struct provEntry_s * ea = a, * eb = b;
+
+    if (ea->name != eb->name)
+	return (ea->name < eb->name) ? -1 : 1;
+    if (ea->pkg != eb->pkg)
+	return (ea->pkg < eb->pkg) ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Sort the provides, index them by name and split the EVRs.
+ */
+static void provFinish(struct provIndex_s * idx)
+{
+    unsigned int nkeys = strpoolCount(idx->pool);
+    unsigned int key;
+    int i;
+
+    qsort(idx->entries, idx->n, sizeof(*idx->entries), provEntryCmp);
+    idx->start = xmalloc((nkeys + 2) * sizeof(*idx->start));
+    for (i = 0, key = 0; key <= nkeys + 1; key++) {
+	while (i < idx->n && idx->entries[i].name < key)
+	    i++;
+	idx->start[key] = i;
+    }
+
+    idx->evrs = xcalloc(nkeys + 1, sizeof(*idx->evrs));
+    for (i = 0; i < idx->n; i++) {
+	unsigned int evr = idx->entries[i].evr;
+	if (evr && idx->evrs[evr].buf == NULL)
+	    dsSplitEVR(&idx->evrs[evr], strpoolStr(idx->pool, evr));
+    }
+}
+
+static struct provIndex_s * provFree(struct provIndex_s * idx)
+{
+    unsigned int i;
+
+    if (idx) {
+	if (idx->evrs) {
+	    for (i = 0; i <= strpoolCount(idx->pool); i++)
+		free(idx->evrs[i].buf);
+	}
+	free(idx->evrs);
+	free(idx->start);
+	free(idx->entries);
+	idx->pool = strpoolFree(idx->pool);
+	free(idx);
+    }
+    return NULL;
+}
+
+/**
+ * Find the packages satisfying a dependency. Safe to call without the GIL.
+ */
+static void provResolve(struct provIndex_s * idx, struct provQuery_s * q)
+{
+    unsigned int id = strpoolId(idx->pool, q->N, 0);
+    unsigned int i;
+    int nalloced = 0;
+
+    if (id == 0)
+	return;
+
+    for (i = idx->start[id]; i < idx->start[id + 1]; i++) {
+	struct provEntry_s * e = idx->entries + i;
+
+	/* entries are sorted by package, duplicates are adjacent */
+	if (q->npkgs > 0 && q->pkgs[q->npkgs - 1] == e->pkg)
+	    continue;
+	if (!dsOverlapEVR(e->flags, e->evr ? &idx->evrs[e->evr] : NULL,
+			  q->flags, &q->evr, q->nopromote))
+	    continue;
+	if (q->npkgs == nalloced) {
+	    nalloced = nalloced ? 2 * nalloced : 4;
+	    q->pkgs = xrealloc(q->pkgs, nalloced * sizeof(*q->pkgs));
+	}
+	q->pkgs[q->npkgs++] = e->pkg;
+    }
+}
+
+/**
+ * Copy a python dependency into a query. Sets python error on failure.
+ */
+static int provQueryInit(struct provQuery_s * q, PyObject * o)
+{
+    rpmds dep = dsSingleFromPyObject(o, RPMTAG_REQUIRENAME);
+
+    memset(q, 0, sizeof(*q));
+    if (dep == NULL)
+	return -1;
+    (void) rpmdsNext(rpmdsInit(dep));
+    q->N = xstrdup(rpmdsN(dep));
+    q->flags = rpmdsFlags(dep);
+    q->nopromote = rpmdsNoPromote(dep);
+    dsSplitEVR(&q->evr, rpmdsEVR(dep));
+    dep = rpmdsFree(dep);
+    return 0;
+}
+
+static PyObject * provQueryResult(struct provQuery_s * q)
+{
+    PyObject * list = PyList_New(q->npkgs);
+    int i;
+
+    for (i = 0; list && i < q->npkgs; i++)
+	PyList_SET_ITEM(list, i, PyInt_FromLong(q->pkgs[i]));
+    return list;
+}
+
+static void provQueryFree(struct provQuery_s * q)
+{
+    free(q->N);
+    free(q->evr.buf);
+    free(q->pkgs);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmProvidesIndex_Satisfies(rpmProvidesIndexObject * s, PyObject * args,
+		PyObject * kwds)
+{
+    struct provQuery_s q;
+    PyObject * o, * result;
+    char * kwlist[] = {"dep", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:Satisfies", kwlist, &o))
+	return NULL;
+    if (provQueryInit(&q, o))
+	return NULL;
+
+    provResolve(s->idx, &q);
+    result = provQueryResult(&q);
+    provQueryFree(&q);
+
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmProvidesIndex_Resolve(rpmProvidesIndexObject * s, PyObject * args,
+		PyObject * kwds)
+{
+    struct provQuery_s * qs;
+    PyObject * deps, * seq, * result = NULL;
+    int i, n, nq = 0;
+    char * kwlist[] = {"deps", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:Resolve", kwlist, &deps))
+	return NULL;
+    if ((seq = PySequence_Fast(deps, "sequence of dependencies expected")) == NULL)
+	return NULL;
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    qs = xcalloc(n ? n : 1, sizeof(*qs));
+    for (nq = 0; nq < n; nq++) {
+	if (provQueryInit(&qs[nq], PySequence_Fast_GET_ITEM(seq, nq)))
+	    goto exit;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < nq; i++)
+	provResolve(s->idx, &qs[i]);
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(nq);
+    for (i = 0; result && i < nq; i++)
+	PyList_SET_ITEM(result, i, provQueryResult(&qs[i]));
+
+exit:
+    for (i = 0; i < nq; i++)
+	provQueryFree(&qs[i]);
+    free(qs);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static struct PyMethodDef rpmProvidesIndex_methods[] = {
+ {"satisfies",	(PyCFunction) rpmProvidesIndex_Satisfies,	METH_VARARGS|METH_KEYWORDS,
+"idx.satisfies(dep) -> [pkg, ...]\n\
+- Return ids of the packages with a provide (or file) matching dep.\n" },
+ {"resolve",	(PyCFunction) rpmProvidesIndex_Resolve,	METH_VARARGS|METH_KEYWORDS,
+"idx.resolve(deps) -> [[pkg, ...], ...]\n\
+- Return ids of the packages satisfying each of a list of dependencies.\n" },
+    {NULL,		NULL}		/* sentinel */
+};
+
+/** \ingroup py_c
+ */
+static Py_ssize_t rpmProvidesIndex_length(rpmProvidesIndexObject * s)
+{
+    return s->idx->n;
+}
+
+static PySequenceMethods rpmProvidesIndex_as_sequence = {
+	(lenfunc) rpmProvidesIndex_length,	/* sq_length */
+};
+
+/** \ingroup py_c
+ */
+static void rpmProvidesIndex_dealloc(rpmProvidesIndexObject * s)
+{
+    s->idx = provFree(s->idx);
+    PyObject_Del(s);
+}
+
+/** \ingroup py_c
+ */
+static PyObject * rpmProvidesIndex_new(PyTypeObject * subtype, PyObject *args,
+		PyObject *kwds)
+{
+    rpmProvidesIndexObject * s;
+    struct provIndex_s * idx;
+    PyObject * o, * iter, * item;
+    int files = 1;
+    unsigned int pkg = 0;
+    char * kwlist[] = {"packages", "files", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i:ProvidesIndex", kwlist,
+	    &o, &files))
+	return NULL;
+
+    if ((iter = PyObject_GetIter(o)) == NULL)
+	return NULL;
+
+    idx = xcalloc(1, sizeof(*idx));
+    idx->pool = strpoolNew();
+    while ((item = PyIter_Next(iter)) != NULL) {
+	if (!PyObject_TypeCheck(item, &hdr_Type)) {
+	    PyErr_SetString(PyExc_TypeError, "headers expected");
+	    Py_DECREF(item);
+	    break;
+	}
+	/* Installed packages are known by instance, others by position. */
+	if (PyObject_TypeCheck(o, &rpmmi_Type)) {
+	    rpmmiObject * mio = (rpmmiObject *) o;
+	    pkg = (mio->pf != NULL) ? mio->offset
+				    : rpmdbGetIteratorOffset(mio->mi);
+	}
+	provAddHeader(idx, hdrGetHeader((hdrObject *) item), pkg, files);
+	pkg++;
+	Py_DECREF(item);
+    }
+    Py_DECREF(iter);
+    if (PyErr_Occurred()) {
+	provFree(idx);
+	return NULL;
+    }
+
+    provFinish(idx);
+
+    if ((s = PyObject_New(rpmProvidesIndexObject, subtype)) == NULL) {
+	provFree(idx);
+	return PyErr_NoMemory();
+    }
+    s->md_dict = NULL;
+    s->idx = idx;
+
+    debug("%p ++ %d packages %d provides\n", s, idx->npkgs, idx->n);
+
+    return (PyObject *) s;
+}
+
+static char rpmProvidesIndex_doc[] =
+"rpm.ProvidesIndex(headers or mi[, files]) -> idx\n\
+- Index the provides of packages, file provides too unless files=False.";
+
+PyTypeObject rpmProvidesIndex_Type = {
+	PyObject_HEAD_INIT(&PyType_Type)
+	0,				/* ob_size */
+	"rpm.ProvidesIndex",		/* tp_name */
+	sizeof(rpmProvidesIndexObject),	/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor) rpmProvidesIndex_dealloc,/* tp_dealloc */
+	(printfunc)0,			/* tp_print */
+	(getattrfunc)0,			/* tp_getattr */
+	(setattrfunc)0,			/* tp_setattr */
+	(cmpfunc)0,			/* tp_compare */
+	(reprfunc)0,			/* tp_repr */
+	0,				/* tp_as_number */
+	&rpmProvidesIndex_as_sequence,	/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	(hashfunc)0,			/* tp_hash */
+	(ternaryfunc)0,			/* tp_call */
+	(reprfunc)0,			/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	PyObject_GenericSetAttr,	/* tp_setattro */
+	0,				/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, 		/* tp_flags */
+	rpmProvidesIndex_doc,		/* tp_doc */
+	0,				/* tp_traverse */
+	0,				/* tp_clear */
+	(richcmpfunc)0,			/* tp_richcompare */
+	0,				/* tp_weaklistoffset */
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	rpmProvidesIndex_methods,	/* tp_methods */
+	0,				/* tp_members */
+	0,				/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	(initproc)0,			/* tp_init */
+	(allocfunc)0,			/* tp_alloc */
+	(newfunc) rpmProvidesIndex_new,	/* tp_new */
+	(freefunc)0,			/* tp_free */
+	0,				/* tp_is_gc */
+};
@@ -0,0 +1,23 @@
+#ifndef H_RPMPROVIDES_PY
+#define H_RPMPROVIDES_PY
+
+#include <Python.h>
+
+/** \ingroup py_c
+ * \file python/rpmprovides-py.h
+ */
+
+/**
+ * Index of the provides (and file provides) of a set of packages.
+ */
+typedef struct rpmProvidesIndexObject_s {
+    PyObject_HEAD
+    PyObject *md_dict;		/*!< to look like PyModuleObject */
+    struct provIndex_s * idx;
+} rpmProvidesIndexObject;
+
+/**
+ */
+extern PyTypeObject rpmProvidesIndex_Type;
+
+#endif
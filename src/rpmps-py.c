@@ -2,7 +2,12 @@
  * \file python/rpmps-py.c
  */
 
+#include <rpm/rpmds.h>
+#include <rpm/rpmtd.h>
+
 #include "rpmps-py.h"
+#include "rpmds-py.h"
+#include "rpmts-py.h"	/* RPMDEP_SENSE_* */
 #include "rpmdebug-py.h"
 
 static int
@@ -213,3 +218,363 @@ rpmps_Wrap(rpmps ps)
     s->psi = NULL;
     return (PyObject*) s;
 }
+
+/* ---------- */
+
+/**
+ * Split pkgNEVR into name, epoch, version, release and arch on first use.
+ */
+static void rpmProblem_splitPkg(rpmProblemObject * s)
+{
+    const char * nevra;
+    char * t;
+
+    if (s->pkg != NULL)
+	return;
+
+    nevra = rpmProblemGetPkgNEVR(s->prob);
+    s->pkg = xstrdup(nevra ? nevra : "");
+    s->pkgN = s->pkg;
+    if ((t = strrchr(s->pkg, '.')) != NULL) {
+	*t++ = '\0';
+	s->pkgA = t;
+    }
+    if ((t = strrchr(s->pkg, '-')) != NULL) {
+	*t++ = '\0';
+	s->pkgR = t;
+    }
+    if ((t = strrchr(s->pkg, '-')) != NULL) {
+	*t++ = '\0';
+	s->pkgV = t;
+	if ((t = strchr(s->pkgV, ':')) != NULL) {
+	    *t++ = '\0';
+	    s->pkgE = s->pkgV;
+	    s->pkgV = t;
+	}
+    }
+}
+
+/**
+ * Split a dependency altNEVR ("R N op EVR") into its parts on first use.
+ * @return		0 if the problem is a dependency problem
+ */
+static int rpmProblem_splitDep(rpmProblemObject * s)
+{
+    const char * alt;
+    char * op, * t;
+
+    if (s->dep != NULL)
+	return 0;
+
+    switch (rpmProblemGetType(s->prob)) {
+    case RPMPROB_REQUIRES:
+    case RPMPROB_CONFLICT:
+	break;
+    default:
+	return -1;
+    }
+    if ((alt = rpmProblemGetAltNEVR(s->prob)) == NULL)
+	return -1;
+
+    s->dep = xstrdup(alt);
+    s->depN = s->dep;
+    s->sense = RPMDEP_SENSE_REQUIRES;
+    if (s->dep[0] != '\0' && s->dep[1] == ' ') {
+	if (s->dep[0] == 'C')
+	    s->sense = RPMDEP_SENSE_CONFLICTS;
+	s->depN += 2;
+    }
+
+    s->depFlags = RPMSENSE_ANY;
+    if ((t = strrchr(s->depN, ' ')) != NULL) {
+	*t++ = '\0';
+	s->depEVR = t;
+	if ((op = strrchr(s->depN, ' ')) != NULL) {
+	    for (*op++ = '\0'; *op != '\0'; op++) {
+		if (*op == '<')		s->depFlags |= RPMSENSE_LESS;
+		else if (*op == '>')	s->depFlags |= RPMSENSE_GREATER;
+		else if (*op == '=')	s->depFlags |= RPMSENSE_EQUAL;
+	    }
+	}
+    }
+    return 0;
+}
+
+static PyObject * strOrNone(const char * str)
+{
+    if (str == NULL) {
+	Py_RETURN_NONE;
+    }
+    return PyString_FromString(str);
+}
+
+static PyObject *rpmProblem_GetType(rpmProblemObject * s, void *closure)
+{
+    return Py_BuildValue("i", rpmProblemGetType(s->prob));
+}
+
+static PyObject *rpmProblem_GetPkgNEVR(rpmProblemObject * s, void *closure)
+{
+    return strOrNone(rpmProblemGetPkgNEVR(s->prob));
+}
+
+static PyObject *rpmProblem_GetAltNEVR(rpmProblemObject * s, void *closure)
+{
+    return strOrNone(rpmProblemGetAltNEVR(s->prob));
+}
+
+static PyObject *rpmProblem_GetStr(rpmProblemObject * s, void *closure)
+{
+    return strOrNone(rpmProblemGetStr(s->prob));
+}
+
+static PyObject *rpmProblem_GetNum(rpmProblemObject * s, void *closure)
+{
+    return PyLong_FromLongLong(rpmProblemGetDiskNeed(s->prob));
+}
+
+static PyObject *rpmProblem_GetKey(rpmProblemObject * s, void *closure)
+{
+    PyObject * key = s->key ? s->key : Py_None;
+    Py_INCREF(key);
+    return key;
+}
+
+/**
+ * Return a header tag as a python string, None if not present.
+ */
+static PyObject * hdrStrOrNone(Header h, rpmTag tag)
+{
+    rpmtd td = rpmtdNew();
+    PyObject * res = NULL;
+
+    if (headerGet(h, tag, td, HEADERGET_MINMEM)) {
+	char * str = rpmtdFormat(td, RPMTD_FORMAT_STRING, NULL);
+	res = strOrNone(str);
+	free(str);
+    }
+    rpmtdFreeData(td);
+    td = rpmtdFree(td);
+    if (res == NULL && !PyErr_Occurred()) {
+	Py_INCREF(Py_None);
+	res = Py_None;
+    }
+    return res;
+}
+
+static PyObject *rpmProblem_GetPkgField(rpmProblemObject * s, void *closure)
+{
+    static const rpmTag tags[] = {
+	RPMTAG_NAME, RPMTAG_EPOCH, RPMTAG_VERSION, RPMTAG_RELEASE, RPMTAG_ARCH
+    };
+    const char * fields = "NEVRA";
+    int i = strchr(fields, (int)(long) closure) - fields;
+
+    if (s->te != NULL) {
+	switch ((long) closure) {
+	case 'N':	return strOrNone(rpmteN(s->te));
+	case 'E':	return strOrNone(rpmteE(s->te));
+	case 'V':	return strOrNone(rpmteV(s->te));
+	case 'R':	return strOrNone(rpmteR(s->te));
+	case 'A':	return strOrNone(rpmteA(s->te));
+	}
+    }
+
+    /* installed packages are loaded on first access */
+    if (s->instance != 0 && s->h == NULL)
+	s->h = rpmtsInstanceHeader((rpmtsObject *) s->tso, s->instance);
+    if (s->h != NULL)
+	return hdrStrOrNone(s->h, tags[i]);
+
+    rpmProblem_splitPkg(s);
+    switch ((long) closure) {
+    case 'N':	return strOrNone(s->pkgN);
+    case 'E':	return strOrNone(s->pkgE);
+    case 'V':	return strOrNone(s->pkgV);
+    case 'R':	return strOrNone(s->pkgR);
+    case 'A':	return strOrNone(s->pkgA);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *rpmProblem_GetDepField(rpmProblemObject * s, void *closure)
+{
+    const char * EVR;
+
+    if (s->ds != NULL) {
+	switch ((long) closure) {
+	case 'N':	return strOrNone(rpmdsN(s->ds));
+	case 'V':
+	    EVR = rpmdsEVR(s->ds);
+	    return strOrNone(EVR && *EVR ? EVR : NULL);
+	case 'F':
+	    return Py_BuildValue("i", rpmdsFlags(s->ds) & RPMSENSE_SENSEMASK);
+	case 'S':
+	    return Py_BuildValue("i", rpmdsTagN(s->ds) == RPMTAG_CONFLICTNAME ?
+			RPMDEP_SENSE_CONFLICTS : RPMDEP_SENSE_REQUIRES);
+	}
+	Py_RETURN_NONE;
+    }
+
+    if (rpmProblem_splitDep(s)) {
+	Py_RETURN_NONE;
+    }
+    switch ((long) closure) {
+    case 'N':	return strOrNone(s->depN);
+    case 'V':	return strOrNone(s->depEVR);
+    case 'F':	return Py_BuildValue("i", s->depFlags);
+    case 'S':	return Py_BuildValue("i", s->sense);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *rpmProblem_GetDS(rpmProblemObject * s, void *closure)
+{
+    rpmTag tagN;
+
+    /* a fresh copy, the caller may move its index */
+    if (s->ds != NULL)
+	return rpmds_Wrap(rpmdsSingle(rpmdsTagN(s->ds), rpmdsN(s->ds),
+				      rpmdsEVR(s->ds), rpmdsFlags(s->ds)));
+
+    if (rpmProblem_splitDep(s)) {
+	Py_RETURN_NONE;
+    }
+    tagN = (s->sense == RPMDEP_SENSE_CONFLICTS) ?
+		RPMTAG_CONFLICTNAME : RPMTAG_REQUIRENAME;
+    return rpmds_Wrap(rpmdsSingle(tagN, s->depN,
+				  s->depEVR ? s->depEVR : "", s->depFlags));
+}
+
+static PyGetSetDef rpmProblem_getseters[] = {
+    { "type",		(getter)rpmProblem_GetType, NULL,
+	"problem type (rpm.RPMPROB_*)", NULL },
+    { "pkgNEVR",	(getter)rpmProblem_GetPkgNEVR, NULL,
+	"name-[epoch:]version-release.arch of the package", NULL },
+    { "altNEVR",	(getter)rpmProblem_GetAltNEVR, NULL,
+	"related package or dependency", NULL },
+    { "str",		(getter)rpmProblem_GetStr, NULL,
+	"generic data string", NULL },
+    { "num",		(getter)rpmProblem_GetNum, NULL,
+	"generic number (disk space/nodes needed)", NULL },
+    { "key",		(getter)rpmProblem_GetKey, NULL,
+	"transaction element key of the package", NULL },
+    { "name",		(getter)rpmProblem_GetPkgField, NULL,
+	"package name", (void *) 'N' },
+    { "epoch",		(getter)rpmProblem_GetPkgField, NULL,
+	"package epoch (or None)", (void *) 'E' },
+    { "version",	(getter)rpmProblem_GetPkgField, NULL,
+	"package version", (void *) 'V' },
+    { "release",	(getter)rpmProblem_GetPkgField, NULL,
+	"package release", (void *) 'R' },
+    { "arch",		(getter)rpmProblem_GetPkgField, NULL,
+	"package arch", (void *) 'A' },
+    { "depName",	(getter)rpmProblem_GetDepField, NULL,
+	"dependency name (dependency problems only)", (void *) 'N' },
+    { "depEVR",		(getter)rpmProblem_GetDepField, NULL,
+	"dependency [epoch:]version[-release]", (void *) 'V' },
+    { "depFlags",	(getter)rpmProblem_GetDepField, NULL,
+	"dependency rpm.RPMSENSE_* comparison flags", (void *) 'F' },
+    { "sense",		(getter)rpmProblem_GetDepField, NULL,
+	"rpm.RPMDEP_SENSE_REQUIRES or rpm.RPMDEP_SENSE_CONFLICTS", (void *) 'S' },
+    { "ds",		(getter)rpmProblem_GetDS, NULL,
+	"dependency as a single element rpm.ds", NULL },
+    { NULL }
+};
+
+static PyObject *rpmProblem_str(rpmProblemObject * s)
+{
+    char * str = rpmProblemString(s->prob);
+    PyObject * res = PyString_FromString(str);
+    free(str);
+    return res;
+}
+
+static void rpmProblem_dealloc(rpmProblemObject * s)
+{
+    free(s->pkg);
+    free(s->dep);
+    s->ds = rpmdsFree(s->ds);
+    s->h = headerFree(s->h);
+    Py_XDECREF(s->tso);
+    Py_XDECREF(s->key);
+    s->ps = rpmpsFree(s->ps);
+    PyObject_Del(s);
+}
+
+static char rpmProblem_doc[] =
+"";
+
+PyTypeObject rpmProblem_Type = {
+	PyObject_HEAD_INIT(&PyType_Type)
+	0,				/* ob_size */
+	"rpm.prob",			/* tp_name */
+	sizeof(rpmProblemObject),	/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor) rpmProblem_dealloc,/* tp_dealloc */
+	(printfunc)0,			/* tp_print */
+	(getattrfunc)0,			/* tp_getattr */
+	(setattrfunc)0,			/* tp_setattr */
+	(cmpfunc)0,			/* tp_compare */
+	(reprfunc)0,			/* tp_repr */
+	0,				/* tp_as_number */
+	0,				/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	(hashfunc)0,			/* tp_hash */
+	(ternaryfunc)0,			/* tp_call */
+	(reprfunc)rpmProblem_str,	/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	PyObject_GenericSetAttr,	/* tp_setattro */
+	0,				/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, 		/* tp_flags */
+	rpmProblem_doc,			/* tp_doc */
+	0,				/* tp_traverse */
+	0,				/* tp_clear */
+	(richcmpfunc)0,			/* tp_richcompare */
+	0,				/* tp_weaklistoffset */
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	0,				/* tp_methods */
+	0,				/* tp_members */
+	rpmProblem_getseters,		/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	(initproc)0,			/* tp_init */
+	(allocfunc)0,			/* tp_alloc */
+	(newfunc)0,			/* tp_new */
+	(freefunc)0,			/* tp_free */
+	0,				/* tp_is_gc */
+};
+
+PyObject *
+rpmProblem_Wrap(rpmps ps, rpmProblem prob,
+		PyObject * tso, rpmte te, unsigned int instance, rpmds ds)
+{
+    rpmProblemObject * s = PyObject_New(rpmProblemObject, &rpmProblem_Type);
+
+    if (s == NULL) {
+	return PyErr_NoMemory();
+    }
+    s->ps = rpmpsLink(ps, "rpmProblem_Wrap");
+    s->prob = prob;
+    s->key = (PyObject *) rpmProblemGetKey(prob);
+    Py_XINCREF(s->key);
+    /* the ts keeps te alive and can load the installed header */
+    s->tso = (te != NULL || instance != 0) ? tso : NULL;
+    Py_XINCREF(s->tso);
+    s->te = te;
+    s->instance = instance;
+    s->h = NULL;
+    s->ds = rpmdsLink(ds, "rpmProblem_Wrap");
+    s->pkg = NULL;
+    s->pkgN = s->pkgE = s->pkgV = s->pkgR = s->pkgA = NULL;
+    s->dep = NULL;
+    s->depN = s->depEVR = NULL;
+    s->depFlags = 0;
+    s->sense = RPMDEP_SENSE_REQUIRES;
+    return (PyObject*) s;
+}
@@ -4,6 +4,8 @@
 #include <Python.h>
 
 #include <rpm/rpmps.h>
+#include <rpm/rpmte.h>
+#include <rpm/rpmds.h>
 
 /** \ingroup py_c
  * \file python/rpmps-py.h
@@ -18,10 +20,38 @@ typedef struct rpmpsObject_s {
     rpmpsi	psi;
 } rpmpsObject;
 
+/**
+ * A single problem. Fields are looked up when accessed: from the element
+ * (or installed package) and dependency the problem was made from when
+ * known, otherwise split from the problem strings.
+ */
+typedef struct rpmProblemObject_s {
+    PyObject_HEAD
+    PyObject *md_dict;		/*!< to look like PyModuleObject */
+    rpmps	ps;		/*!< linked, keeps prob valid */
+    rpmProblem	prob;
+    PyObject *	key;
+    PyObject *	tso;		/*!< rpm.ts of te/instance (or NULL) */
+    rpmte	te;		/*!< element with the problem (or NULL) */
+    unsigned int instance;	/*!< installed package with the problem (or 0) */
+    Header	h;		/*!< header of instance, loaded on demand */
+    rpmds	ds;		/*!< linked dependency (or NULL) */
+    char *	pkg;		/*!< split copy of pkgNEVR */
+    const char * pkgN, * pkgE, * pkgV, * pkgR, * pkgA;
+    char *	dep;		/*!< split copy of altNEVR */
+    const char * depN, * depEVR;
+    rpmsenseFlags depFlags;
+    int		sense;
+} rpmProblemObject;
+
 /**
  */
 extern PyTypeObject rpmps_Type;
 
+/**
+ */
+extern PyTypeObject rpmProblem_Type;
+
 /**
  */
 rpmps psFromPs(rpmpsObject * ps);
@@ -30,4 +60,16 @@ rpmps psFromPs(rpmpsObject * ps);
  */
 PyObject * rpmps_Wrap(rpmps ps);
 
+/**
+ * Wrap a problem of a problem set.
+ * @param ps		problem set (linked while the object exists)
+ * @param prob		problem from ps
+ * @param tso		rpm.ts the problem was found in
+ * @param te		element the problem is about (or NULL)
+ * @param instance	installed package the problem is about (or 0)
+ * @param ds		dependency of the problem, single (or NULL)
+ */
+PyObject * rpmProblem_Wrap(rpmps ps, rpmProblem prob,
+		PyObject * tso, rpmte te, unsigned int instance, rpmds ds);
+
 #endif
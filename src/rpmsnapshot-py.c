@@ -0,0 +1,557 @@
+/** \ingroup py_c
+ * \file python/rpmsnapshot-py.c
+ */
+
+#include <rpm/rpmdb.h>
+#include <rpm/rpmds.h>
+#include <rpm/rpmfi.h>
+#include <rpm/rpmfileutil.h>
+
+#include "header-py.h"
+#include "rpmsnapshot-py.h"
+#include "rpmcheck-py.h"
+#include "rpmds-py.h"
+#include "strpool-py.h"
+#include "rpmdebug-py.h"
+
+/** \ingroup python
+ * \class Rpmsnapshot
+ * \brief A python rpm.snapshot object represents the installed packages
+ *	of a transaction set's rpmdb at one point in time.
+ *
+ * A snapshot is taken with ts.snapshot(). It holds the NEVRA, provides,
+ * requires and file lists of every installed package in memory, with all
+ * strings interned, and answers queries without touching the rpmdb. The
+ * snapshot never changes by itself; snap.isStale() tells whether the rpmdb
+ * has been modified since, and snap.refresh() rebuilds it then.
+ *
+ * Queries return instances (rpmdb offsets), as ts.whatProvides() does.
+ */
+
+/**
+ * An entry of a snapshot table: a dependency (key is the name, evr the
+ * EVR, 0 if unversioned) or a file (key is the basename, aux the dirname).
+ */
+struct snapEntry_s {
+    unsigned int key;
+    unsigned int aux;
+    unsigned int pkg;		/*!< instance */
+    rpmsenseFlags flags;
+};
+
+/**
+ * Entries sorted by key and instance, start[key] .. start[key + 1] is the
+ * posting list of a key.
+ */
+struct snapTable_s {
+    struct snapEntry_s * entries;
+    int n;
+    int nalloced;
+    unsigned int * start;
+};
+
+/**
+ */
+struct snapPkg_s {
+    unsigned int offset;	/*!< instance */
+    unsigned int nevra;
+};
+
+/**
+ * The snapshot proper, immutable once built.
+ */
+struct rpmsnapshot_s {
+    strpool pool;
+    struct snapPkg_s * pkgs;	/*!< sorted by instance */
+    int npkgs;
+    int nalloced;
+    struct snapTable_s provides;
+    struct snapTable_s requires;
+    struct snapTable_s files;
+};
+
+static void snapTableAdd(struct snapTable_s * t, unsigned int key,
+		unsigned int aux, unsigned int pkg, rpmsenseFlags flags)
+{
+    struct snapEntry_s * e;
+
+    if (t->n == t->nalloced) {
+	t->nalloced = t->nalloced ? 2 * t->nalloced : 1024;
+	t->entries = xrealloc(t->entries, t->nalloced * sizeof(*t->entries));
+    }
+    e = t->entries + t->n++;
+    e->key = key;
+    e->aux = aux;
+    e->pkg = pkg;
+    e->flags = flags;
+}
+
+static int snapEntryCmp(const void * a, const void * b)
+{
+    const struct snapEntry_s * ea = a, * eb = b;
+
+    if (ea->key != eb->key)
+	return (ea->key < eb->key) ? -1 : 1;
+    if (ea->pkg != eb->pkg)
+	return (ea->pkg < eb->pkg) ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Sort a table and build its posting list index.
+ */
+static void snapTableIndex(struct snapTable_s * t, unsigned int nkeys)
+{
+    unsigned int key;
+    int i;
+
+    qsort(t->entries, t->n, sizeof(*t->entries), snapEntryCmp);
+    t->start = xmalloc((nkeys + 2) * sizeof(*t->start));
+    for (i = 0, key = 0; key <= nkeys + 1; key++) {
+	while (i < t->n && t->entries[i].key < key)
+	    i++;
+	t->start[key] = i;
+    }
+}
+
+static void snapTableFree(struct snapTable_s * t)
+{
+    free(t->entries);
+    free(t->start);
+}
+
+static void snapAddDeps(struct rpmsnapshot_s * snap, struct snapTable_s * t,
+		Header h, rpmTag tagN, unsigned int pkg)
+{
+    rpmds ds = rpmdsInit(rpmdsNew(h, tagN, 0));
+
+    while (rpmdsNext(ds) >= 0) {
+	const char * EVR = rpmdsEVR(ds);
+	unsigned int evr = (EVR && *EVR) ? strpoolId(snap->pool, EVR, 1) : 0;
+	snapTableAdd(t, strpoolId(snap->pool, rpmdsN(ds), 1), evr, pkg,
+		     rpmdsFlags(ds));
+    }
+    ds = rpmdsFree(ds);
+}
+
+static int snapPkgCmp(const void * a, const void * b)
+{
+    const struct snapPkg_s * pa = a, * pb = b;
+
+    if (pa->offset != pb->offset)
+	return (pa->offset < pb->offset) ? -1 : 1;
+    return 0;
+}
+
+static struct rpmsnapshot_s * snapFree(struct rpmsnapshot_s * snap)
+{
+    if (snap) {
+	snap->pool = strpoolFree(snap->pool);
+	free(snap->pkgs);
+	snapTableFree(&snap->provides);
+	snapTableFree(&snap->requires);
+	snapTableFree(&snap->files);
+	free(snap);
+    }
+    return NULL;
+}
+
+/**
+ * Build a snapshot from an iterator, which is freed.
+ */
+static struct rpmsnapshot_s * snapBuild(rpmdbMatchIterator mi)
+{
+    struct rpmsnapshot_s * snap = xcalloc(1, sizeof(*snap));
+    unsigned int nkeys;
+    Header h;
+
+    snap->pool = strpoolNew();
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	unsigned int pkg = rpmdbGetIteratorOffset(mi);
+	char * nevra = headerFormat(h, HEADER_NEVRA_FMT, NULL);
+	rpmfi fi;
+
+	if (snap->npkgs == snap->nalloced) {
+	    snap->nalloced = snap->nalloced ? 2 * snap->nalloced : 256;
+	    snap->pkgs = xrealloc(snap->pkgs,
+				  snap->nalloced * sizeof(*snap->pkgs));
+	}
+	snap->pkgs[snap->npkgs].offset = pkg;
+	snap->pkgs[snap->npkgs].nevra = strpoolId(snap->pool, nevra, 1);
+	snap->npkgs++;
+	free(nevra);
+
+	snapAddDeps(snap, &snap->provides, h, RPMTAG_PROVIDENAME, pkg);
+	snapAddDeps(snap, &snap->requires, h, RPMTAG_REQUIRENAME, pkg);
+
+	fi = rpmfiInit(rpmfiNew(NULL, h, RPMTAG_BASENAMES, 0), 0);
+	while (rpmfiNext(fi) >= 0) {
+	    snapTableAdd(&snap->files, strpoolId(snap->pool, rpmfiBN(fi), 1),
+			 strpoolId(snap->pool, rpmfiDN(fi), 1), pkg, 0);
+	}
+	fi = rpmfiFree(fi);
+    }
+    mi = rpmdbFreeIterator(mi);
+
+    qsort(snap->pkgs, snap->npkgs, sizeof(*snap->pkgs), snapPkgCmp);
+    nkeys = strpoolCount(snap->pool);
+    snapTableIndex(&snap->provides, nkeys);
+    snapTableIndex(&snap->requires, nkeys);
+    snapTableIndex(&snap->files, nkeys);
+
+    return snap;
+}
+
+/**
+ * Append an instance known not to be in the set yet.
+ */
+static void instancesAppend(struct instances_s * insts, unsigned int offset)
+{
+    if (insts->n == insts->nalloced) {
+	insts->nalloced = insts->nalloced ? 2 * insts->nalloced : 8;
+	insts->offsets = xrealloc(insts->offsets,
+				  insts->nalloced * sizeof(*insts->offsets));
+    }
+    insts->offsets[insts->n++] = offset;
+}
+
+/**
+ * Find the owners of a file path.
+ */
+static void snapWhatOwns(struct rpmsnapshot_s * snap, const char * path,
+		struct instances_s * insts)
+{
+    const char * bn = strrchr(path, '/');
+    unsigned int dnid, bnid, i;
+
+    if (bn == NULL)
+	return;
+    bn++;
+    /* dirnames are kept with their trailing slash */
+    dnid = strpoolIdn(snap->pool, path, bn - path, 0);
+    bnid = strpoolId(snap->pool, bn, 0);
+    if (dnid == 0 || bnid == 0)
+	return;
+
+    for (i = snap->files.start[bnid]; i < snap->files.start[bnid + 1]; i++) {
+	if (snap->files.entries[i].aux == dnid)
+	    instancesAdd(insts, snap->files.entries[i].pkg);
+    }
+}
+
+/**
+ * Find entries of a dependency table matching a dependency.
+ * @param snap		snapshot
+ * @param t		table (provides or requires)
+ * @param dep		dependency (current entry)
+ * @param tagN		dependency tag of the table
+ * @retval insts	matching instances
+ */
+static void snapWhatDeps(struct rpmsnapshot_s * snap, struct snapTable_s * t,
+		rpmds dep, rpmTag tagN, struct instances_s * insts)
+{
+    const char * N = rpmdsN(dep);
+    int ranged = (rpmdsFlags(dep) & RPMSENSE_SENSEMASK) != 0;
+    unsigned int id = strpoolId(snap->pool, N, 0);
+    unsigned int i;
+
+    if (id == 0)
+	return;
+
+    for (i = t->start[id]; i < t->start[id + 1]; i++) {
+	struct snapEntry_s * e = t->entries + i;
+	int match = 1;
+
+	/* only compare EVRs if both sides carry a range */
+	if (ranged && e->aux && (e->flags & RPMSENSE_SENSEMASK)) {
+	    rpmds ds = rpmdsSingle(tagN, N, strpoolStr(snap->pool, e->aux),
+				   e->flags);
+	    (void) rpmdsNext(rpmdsInit(ds));
+	    match = rpmdsCompare(ds, dep);
+	    ds = rpmdsFree(ds);
+	}
+	/* posting lists are sorted by instance, duplicates are adjacent */
+	if (match && (insts->n == 0 || insts->offsets[insts->n - 1] != e->pkg))
+	    instancesAppend(insts, e->pkg);
+    }
+}
+
+/**
+ * Convert instances to a python list.
+ */
+static PyObject * instancesList(struct instances_s * insts)
+{
+    PyObject * list = PyList_New(insts->n);
+    int i;
+
+    for (i = 0; i < insts->n; i++)
+	PyList_SET_ITEM(list, i, PyInt_FromLong(insts->offsets[i]));
+    free(insts->offsets);
+    return list;
+}
+
+/**
+ * (Re)build the snapshot of a snapshot object.
+ */
+static int rpmsnapshotBuild(rpmsnapshotObject * s)
+{
+    rpmdbMatchIterator mi;
+    struct rpmsnapshot_s * snap;
+
+    /* take the stamp first, a change while building leaves us stale */
+    (void) rpmdbStampCheck(s->pkgpath, &s->stamp, 1);
+    if ((mi = rpmtsPackagesIterator(s->ts)) == NULL)
+	return -1;
+
+    Py_BEGIN_ALLOW_THREADS
+    snap = snapBuild(mi);
+    Py_END_ALLOW_THREADS
+
+    s->snap = snapFree(s->snap);
+    s->snap = snap;
+    return 0;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_WhatProvides(rpmsnapshotObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * o;
+    struct instances_s insts = { 0, 0, NULL };
+    rpmds dep;
+    char * kwlist[] = {"dep", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:WhatProvides", kwlist, &o))
+	return NULL;
+    if ((dep = dsSingleFromPyObject(o, RPMTAG_REQUIRENAME)) == NULL)
+	return NULL;
+
+    (void) rpmdsNext(rpmdsInit(dep));
+    snapWhatDeps(s->snap, &s->snap->provides, dep, RPMTAG_PROVIDENAME, &insts);
+    if (*rpmdsN(dep) == '/')
+	snapWhatOwns(s->snap, rpmdsN(dep), &insts);
+    dep = rpmdsFree(dep);
+
+    return instancesList(&insts);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_WhatRequires(rpmsnapshotObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * o;
+    struct instances_s insts = { 0, 0, NULL };
+    rpmds dep;
+    char * kwlist[] = {"dep", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:WhatRequires", kwlist, &o))
+	return NULL;
+    if ((dep = dsSingleFromPyObject(o, RPMTAG_PROVIDENAME)) == NULL)
+	return NULL;
+
+    (void) rpmdsNext(rpmdsInit(dep));
+    snapWhatDeps(s->snap, &s->snap->requires, dep, RPMTAG_REQUIRENAME, &insts);
+    dep = rpmdsFree(dep);
+
+    return instancesList(&insts);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_WhatOwns(rpmsnapshotObject * s, PyObject * args, PyObject * kwds)
+{
+    const char * path;
+    struct instances_s insts = { 0, 0, NULL };
+    char * kwlist[] = {"path", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s:WhatOwns", kwlist, &path))
+	return NULL;
+
+    snapWhatOwns(s->snap, path, &insts);
+    return instancesList(&insts);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_NEVRA(rpmsnapshotObject * s, PyObject * args, PyObject * kwds)
+{
+    struct snapPkg_s key, * pkg;
+    unsigned int instance;
+    char * kwlist[] = {"instance", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "I:NEVRA", kwlist, &instance))
+	return NULL;
+
+    key.offset = instance;
+    pkg = bsearch(&key, s->snap->pkgs, s->snap->npkgs, sizeof(*pkg),
+		  snapPkgCmp);
+    if (pkg == NULL) {
+	PyErr_SetString(PyExc_KeyError, "no such instance");
+	return NULL;
+    }
+    return PyString_FromString(strpoolStr(s->snap->pool, pkg->nevra));
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_Instances(rpmsnapshotObject * s)
+{
+    PyObject * list = PyList_New(s->snap->npkgs);
+    int i;
+
+    for (i = 0; i < s->snap->npkgs; i++)
+	PyList_SET_ITEM(list, i, PyInt_FromLong(s->snap->pkgs[i].offset));
+    return list;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_IsStale(rpmsnapshotObject * s)
+{
+    return PyBool_FromLong(rpmdbStampCheck(s->pkgpath, &s->stamp, 0));
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmsnapshot_Refresh(rpmsnapshotObject * s, PyObject * args, PyObject * kwds)
+{
+    int force = 0;
+    char * kwlist[] = {"force", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i:Refresh", kwlist, &force))
+	return NULL;
+
+    if (!force && !rpmdbStampCheck(s->pkgpath, &s->stamp, 0))
+	Py_RETURN_FALSE;
+    if (rpmsnapshotBuild(s))
+	return NULL;
+    Py_RETURN_TRUE;
+}
+
+/** \ingroup py_c
+ */
+static struct PyMethodDef rpmsnapshot_methods[] = {
+ {"whatProvides",	(PyCFunction) rpmsnapshot_WhatProvides,	METH_VARARGS|METH_KEYWORDS,
+"snap.whatProvides(dep) -> [instance, ...]\n\
+- Return instances of packages providing a dependency, given as an rpm.ds\n\
+  object (current entry), a (N, Flags, EVR) tuple or a plain name.\n\
+  File dependencies are looked up in the file lists as well.\n" },
+ {"whatRequires",	(PyCFunction) rpmsnapshot_WhatRequires,	METH_VARARGS|METH_KEYWORDS,
+"snap.whatRequires(dep) -> [instance, ...]\n\
+- Return instances of packages with a requirement matched by a provided\n\
+  dependency, given as for snap.whatProvides().\n" },
+ {"whatOwns",	(PyCFunction) rpmsnapshot_WhatOwns,	METH_VARARGS|METH_KEYWORDS,
+"snap.whatOwns(path) -> [instance, ...]\n\
+- Return instances of packages owning a file path.\n" },
+ {"nevra",	(PyCFunction) rpmsnapshot_NEVRA,	METH_VARARGS|METH_KEYWORDS,
+"snap.nevra(instance) -> nevra\n\
+- Return the name-[epoch:]version-release.arch of an instance.\n" },
+ {"instances",	(PyCFunction) rpmsnapshot_Instances,	METH_NOARGS,
+"snap.instances() -> [instance, ...]\n\
+- Return instances of all packages in the snapshot.\n" },
+ {"isStale",	(PyCFunction) rpmsnapshot_IsStale,	METH_NOARGS,
+"snap.isStale() -> bool\n\
+- Has the rpmdb changed since the snapshot was taken?\n" },
+ {"refresh",	(PyCFunction) rpmsnapshot_Refresh,	METH_VARARGS|METH_KEYWORDS,
+"snap.refresh([force]) -> bool\n\
+- Rebuild the snapshot if the rpmdb has changed (or force is set).\n\
+  Returns whether the snapshot was rebuilt.\n" },
+    {NULL,		NULL}		/* sentinel */
+};
+
+/** \ingroup py_c
+ */
+static Py_ssize_t rpmsnapshot_length(rpmsnapshotObject * s)
+{
+    return s->snap->npkgs;
+}
+
+static PySequenceMethods rpmsnapshot_as_sequence = {
+	(lenfunc) rpmsnapshot_length,	/* sq_length */
+};
+
+/** \ingroup py_c
+ */
+static void rpmsnapshot_dealloc(rpmsnapshotObject * s)
+{
+    s->snap = snapFree(s->snap);
+    free(s->pkgpath);
+    Py_XDECREF(s->ts);
+    PyObject_Del(s);
+}
+
+static char rpmsnapshot_doc[] =
+"An in-memory index of the installed packages, see ts.snapshot().";
+
+PyTypeObject rpmsnapshot_Type = {
+	PyObject_HEAD_INIT(&PyType_Type)
+	0,				/* ob_size */
+	"rpm.snapshot",			/* tp_name */
+	sizeof(rpmsnapshotObject),	/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor) rpmsnapshot_dealloc,/* tp_dealloc */
+	(printfunc)0,			/* tp_print */
+	(getattrfunc)0,			/* tp_getattr */
+	(setattrfunc)0,			/* tp_setattr */
+	(cmpfunc)0,			/* tp_compare */
+	(reprfunc)0,			/* tp_repr */
+	0,				/* tp_as_number */
+	&rpmsnapshot_as_sequence,	/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	(hashfunc)0,			/* tp_hash */
+	(ternaryfunc)0,			/* tp_call */
+	(reprfunc)0,			/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	PyObject_GenericSetAttr,	/* tp_setattro */
+	0,				/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, 		/* tp_flags */
+	rpmsnapshot_doc,		/* tp_doc */
+	0,				/* tp_traverse */
+	0,				/* tp_clear */
+	(richcmpfunc)0,			/* tp_richcompare */
+	0,				/* tp_weaklistoffset */
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	rpmsnapshot_methods,		/* tp_methods */
+	0,				/* tp_members */
+	0,				/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	(initproc)0,			/* tp_init */
+	(allocfunc)0,			/* tp_alloc */
+	(newfunc)0,			/* tp_new */
+	(freefunc)0,			/* tp_free */
+	0,				/* tp_is_gc */
+};
+
+PyObject * rpmsnapshot_Create(rpmtsObject * ts)
+{
+    rpmsnapshotObject * s = PyObject_New(rpmsnapshotObject, &rpmsnapshot_Type);
+
+    if (s == NULL)
+	return PyErr_NoMemory();
+
+    s->md_dict = NULL;
+    s->snap = NULL;
+    memset(&s->stamp, 0, sizeof(s->stamp));
+    s->pkgpath = rpmGenPath(rpmtsRootDir(ts->ts), "%{_dbpath}", "Packages");
+    Py_INCREF(ts);
+    s->ts = ts;
+
+    if (rpmsnapshotBuild(s)) {
+	Py_DECREF(s);
+	return NULL;
+    }
+    return (PyObject *) s;
+}
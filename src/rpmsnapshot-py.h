@@ -0,0 +1,36 @@
+#ifndef H_RPMSNAPSHOT_PY
+#define H_RPMSNAPSHOT_PY
+
+#include <Python.h>
+
+#include "rpmts-py.h"
+#include "rpmdbpool-py.h"
+
+/** \ingroup py_c
+ * \file python/rpmsnapshot-py.h
+ */
+
+/**
+ * Read-only index of the installed packages, taken at one point in time.
+ */
+typedef struct rpmsnapshotObject_s {
+    PyObject_HEAD
+    PyObject *md_dict;		/*!< to look like PyModuleObject */
+    rpmtsObject * ts;		/*!< transaction set to rebuild from */
+    char * pkgpath;		/*!< Packages file, for change detection */
+    struct rpmdbStamp_s stamp;	/*!< Packages file when last built */
+    struct rpmsnapshot_s * snap;
+} rpmsnapshotObject;
+
+/**
+ */
+extern PyTypeObject rpmsnapshot_Type;
+
+/**
+ * Take a snapshot of the rpmdb of a transaction set.
+ * @param ts		transaction set
+ * @return		new rpm.snapshot object (NULL with python error set)
+ */
+PyObject * rpmsnapshot_Create(rpmtsObject * ts);
+
+#endif
@@ -0,0 +1,150 @@
+/** \ingroup py_c
+ * \file python/rpmthread-py.c
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <rpm/rpmstring.h>
+
+#include "rpmthread-py.h"
+
+struct rpmpool_s {
+    pthread_t * threads;
+    int nthreads;
+    int nitems;
+    int next;			/*!< next item to hand out */
+    int cancelled;
+    char * done;		/*!< per item completion */
+    rpmpoolFunc func;
+    void * data;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;	/*!< signaled on item completion */
+};
+
+struct rpmpoolWorker_s {
+    rpmpool pool;
+    int worker;
+};
+
+static void * poolThread(void * arg)
+{
+    struct rpmpoolWorker_s * w = arg;
+    rpmpool pool = w->pool;
+    int worker = w->worker;
+    int ix;
+
+    free(w);
+    while (1) {
+	pthread_mutex_lock(&pool->lock);
+	if (pool->cancelled || pool->next >= pool->nitems) {
+	    pthread_mutex_unlock(&pool->lock);
+	    break;
+	}
+	ix = pool->next++;
+	pthread_mutex_unlock(&pool->lock);
+
+	pool->func(pool->data, worker, ix);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->done[ix] = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+    }
+
+    /* Wake up waiters for items that will never be processed. */
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int rpmpoolDefaultWorkers(void)
+{
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (ncpus > 0) ? ncpus : 1;
+}
+
+rpmpool rpmpoolNew(int nworkers, int nitems, rpmpoolFunc func, void * data)
+{
+    rpmpool pool = xcalloc(1, sizeof(*pool));
+    int i;
+
+    if (nworkers > nitems)
+	nworkers = nitems;
+    if (nworkers < 1)
+	nworkers = 1;
+
+    pool->threads = xcalloc(nworkers, sizeof(*pool->threads));
+    pool->nitems = nitems;
+    pool->done = xcalloc(nitems + 1, sizeof(*pool->done));
+    pool->func = func;
+    pool->data = data;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (i = 0; i < nworkers; i++) {
+	struct rpmpoolWorker_s * w = xmalloc(sizeof(*w));
+	w->pool = pool;
+	w->worker = i;
+	if (pthread_create(&pool->threads[i], NULL, poolThread, w)) {
+	    free(w);
+	    break;
+	}
+	pool->nthreads++;
+    }
+
+    if (pool->nthreads == 0) {
+	pool = rpmpoolFree(pool);
+    }
+    return pool;
+}
+
+int rpmpoolWorkers(rpmpool pool)
+{
+    return pool->nthreads;
+}
+
+int rpmpoolWait(rpmpool pool, int ix)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->done[ix]) {
+	if (pool->cancelled && ix >= pool->next) {
+	    rc = -1;
+	    break;
+	}
+	pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
+void rpmpoolCancel(rpmpool pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->cancelled = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+rpmpool rpmpoolFree(rpmpool pool)
+{
+    int i;
+
+    if (pool == NULL)
+	return NULL;
+
+    rpmpoolCancel(pool);
+    for (i = 0; i < pool->nthreads; i++)
+	pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->done);
+    free(pool);
+    return NULL;
+}
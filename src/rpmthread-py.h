@@ -0,0 +1,63 @@
+#ifndef H_RPMTHREAD_PY
+#define H_RPMTHREAD_PY
+
+/** \ingroup py_c
+ * \file python/rpmthread-py.h
+ */
+
+/**
+ * A fixed size pool of native worker threads processing indexed work items.
+ * Items are handed out in index order; results can be waited for per item,
+ * so they can be streamed back to python in order while workers continue.
+ */
+typedef struct rpmpool_s * rpmpool;
+
+/**
+ * Work function, called from a worker thread without the GIL.
+ * @param data		caller data
+ * @param worker	worker number (0 .. nworkers - 1)
+ * @param ix		item index
+ */
+typedef void (*rpmpoolFunc)(void * data, int worker, int ix);
+
+/**
+ * Return default no. of workers (no. of online cpus).
+ */
+int rpmpoolDefaultWorkers(void);
+
+/**
+ * Start a pool processing items 0 .. nitems - 1.
+ * @param nworkers	no. of threads (clamped to 1 .. nitems)
+ * @param nitems	no. of work items
+ * @param func		work function
+ * @param data		caller data passed to func
+ * @return		new pool, NULL on thread creation failure
+ */
+rpmpool rpmpoolNew(int nworkers, int nitems, rpmpoolFunc func, void * data);
+
+/**
+ * Return no. of worker threads of a pool.
+ */
+int rpmpoolWorkers(rpmpool pool);
+
+/**
+ * Wait for an item to be processed. Release the GIL around this.
+ * @param pool		pool
+ * @param ix		item index
+ * @return		0 when done, -1 if the pool was cancelled first
+ */
+int rpmpoolWait(rpmpool pool, int ix);
+
+/**
+ * Stop handing out items, items in progress still finish.
+ */
+void rpmpoolCancel(rpmpool pool);
+
+/**
+ * Cancel remaining items, join the worker threads and free the pool.
+ * Release the GIL around this.
+ * @return		NULL always
+ */
+rpmpool rpmpoolFree(rpmpool pool);
+
+#endif
@@ -2,13 +2,19 @@
  * \file python/rpmts-py.c
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include <rpm/rpmlib.h>	/* rpmReadPackageFile, headerCheck */
 #include <rpm/rpmmacro.h>
 #include <rpm/rpmtag.h>
 #include <rpm/rpmpgp.h>
 #include <rpm/rpmdb.h>
+#include <rpm/fprint.h>
+#include <rpm/rpmkeyring.h>
+#include <rpm/rpmlog.h>
 
 #include "header-py.h"
 #include "rpmds-py.h"	/* XXX for rpmdsNew */
@@ -19,6 +25,12 @@
 #include "rpmts-py.h"
 #include "rpmkeyring-py.h"
 #include "rpmfd-py.h"
+#include "rpmthread-py.h"
+#include "rpmcheck-py.h"
+#include "rpmdbpool-py.h"
+#include "rpmsnapshot-py.h"
+#include "rpmdu-py.h"
+#include "rpmvcache-py.h"
 #include "rpmdebug-py.h"
 
 /** \ingroup python
@@ -30,7 +42,7 @@
  * installation and upgrade of packages.  The rpm.ts object is
  * instantiated by the TransactionSet function in the rpm module.
  *
- * The TransactionSet function takes two optional arguments. The first
+ * The TransactionSet function takes three optional arguments. The first
  * argument is the root path. The second is the verify signature disable flags,
  * a set of the following bits:
  *
@@ -46,6 +58,16 @@
  * -    rpm._RPMVSF_NODIGESTS		if set, don't check digest(s).
  * -    rpm._RPMVSF_NOSIGNATURES	if set, don't check signature(s).
  *
+ * The third argument, sharedDB, makes the rpmdb queries of the transaction
+ * set (ts.dbMatch(), ts.whatOwns(), ts.whatProvides(), ts.whatRequires(),
+ * ts.check(incremental=True), ts.addErase() and alike) use a read-only
+ * rpmdb handle shared by all transaction sets of a thread with the same
+ * root (see rpm.flushDBPool()). As rpmdb handles aren't thread safe,
+ * each thread gets its own, and match iterators of such transaction sets
+ * should not be passed on to other threads. What rpmlib does on its own
+ * (ts.check() without incremental, ts.order(), ts.run()) still opens the
+ * rpmdb of the transaction set.
+ *
  * A rpm.ts object has the following methods:
  *
  * - addInstall(hdr,data,mode)  Add an install element to a transaction set.
@@ -61,41 +83,42 @@
  * - addErase(name) Add an erase element to a transaction set.
  * @param name	the package name to be erased
  *
+ * - addInstallMany(hdrs,keys,mode) Add install elements for a sequence of
+ *		headers (and optional sequence of keys) in one call. On
+ *		failure the elements added so far are not removed again.
+ *
+ * - addEraseMany(items) Add erase elements for a sequence of installed
+ *		headers, rpmdb instances and names/labels. Names are looked
+ *		up in the Name index, or matched in a single rpmdb pass when
+ *		there are many; nothing is added unless every item is
+ *		installed.
+ *
  * - check()	Perform a dependency check on the transaction set. After
  *		headers have been added to a transaction set, a dependency
  *		check can be performed to make sure that all package
  *		dependencies are satisfied.
  * @return	None If there are no unresolved dependencies
- *		Otherwise a list of complex tuples is returned, one tuple per
- *		unresolved dependency, with
- * The format of the dependency tuple is:
- *     ((packageName, packageVersion, packageRelease),
- *      (reqName, reqVersion),
- *      needsFlags,
- *      suggestedPackage,
- *      sense)
- *     packageName, packageVersion, packageRelease are the name,
- *     version, and release of the package that has the unresolved
- *     dependency or conflict.
- *     The reqName and reqVersion are the name and version of the
- *     requirement or conflict.
- *     The needsFlags is a bitfield that describes the versioned
- *     nature of a requirement or conflict.  The constants
- *     rpm.RPMSENSE_LESS, rpm.RPMSENSE_GREATER, and
- *     rpm.RPMSENSE_EQUAL can be logical ANDed with the needsFlags
- *     to get versioned dependency information.
- *     suggestedPackage is a tuple if the dependency check was aware
- *     of a package that solves this dependency problem when the
- *     dependency check was run.  Packages that are added to the
- *     transaction set as "available" are examined during the
- *     dependency check as possible dependency solvers. The tuple
- *     contains two values, (header, suggestedName).  These are set to
- *     the header of the suggested package and its name, respectively.
- *     If there is no known package to solve the dependency problem,
- *     suggestedPackage is None.
- *     The constants rpm.RPMDEP_SENSE_CONFLICTS and
- *     rpm.RPMDEP_SENSE_REQUIRES are set to show a dependency as a
- *     requirement or a conflict.
+ *		Otherwise a list of rpm.prob objects is returned, one per
+ *		unresolved dependency or conflict. The fields of a problem
+ *		are only looked up when accessed, from the element and
+ *		dependency of an incremental check or else by splitting
+ *		the problem strings:
+ *     type			rpm.RPMPROB_REQUIRES or rpm.RPMPROB_CONFLICT
+ *     key			key of the package with the problem, None
+ *				for installed packages.
+ *     pkgNEVR, altNEVR		the raw problem strings.
+ *     name, epoch, version, release, arch
+ *				the package that has the unresolved
+ *				dependency or conflict.
+ *     depName, depEVR, depFlags
+ *				the requirement or conflict. The constants
+ *				rpm.RPMSENSE_LESS, rpm.RPMSENSE_GREATER, and
+ *				rpm.RPMSENSE_EQUAL can be logical ANDed with
+ *				depFlags to get versioned dependency
+ *				information.
+ *     sense			rpm.RPMDEP_SENSE_REQUIRES or
+ *				rpm.RPMDEP_SENSE_CONFLICTS
+ *     ds			the dependency as a single element rpm.ds
  *
  * - ts.order()	Do a topological sort of added element relations.
  * @return	None
@@ -137,6 +160,16 @@
  *	After the transaction set has been populated with install/upgrade or
  *	erase actions, the transaction set can be executed by invoking
  *	the ts.run() method.
+ *	The progressInterval (msecs) and progressBytes arguments throttle
+ *	INST/UNINST/TRANS progress events natively: events arriving sooner
+ *	are dropped, the next one delivered carries the latest amount. The
+ *	first and the final (amount == total) progress of each phase, as
+ *	well as all other events, are always delivered.
+ *	With openKeys=True the key of each added element must be the package
+ *	path, which is then opened by the binding itself: the return value
+ *	of the callback for RPMCALLBACK_INST_OPEN_FILE is ignored. The next
+ *	readahead packages in transaction order are prefetched into the
+ *	page cache by a background thread while the current one installs.
  */
 
 /** \ingroup py_c
@@ -147,6 +180,33 @@ struct rpmtsCallbackType_s {
     rpmtsObject * tso;
     int pythonError;
     PyThreadState *_save;
+    int batch;			/*!< hand unresolved deps over all at once? */
+    rpmds unresolved;		/*!< unresolved deps collected for the callback */
+    int progressInterval;	/*!< min. msecs between progress events */
+    rpm_loff_t progressBytes;	/*!< min. amount between progress events */
+    int progressSeen;		/*!< progress delivered in current phase? */
+    rpm_loff_t lastAmount;	/*!< amount of last delivered progress */
+    struct timeval lastTime;	/*!< time of last delivered progress */
+    struct openPath_s * paths;	/*!< added elements (in order) if keys are paths */
+    int npaths;
+    int pathIx;			/*!< index of last opened element */
+    int readahead;		/*!< no. of following packages to prefetch */
+    int prefetched;		/*!< elements up to here already prefetched */
+    int prefetchWanted;		/*!< prefetch elements up to here */
+    int prefetchStop;		/*!< readahead thread should quit */
+    int prefetchActive;		/*!< readahead thread is running */
+    pthread_t prefetchThread;
+    pthread_mutex_t prefetchLock;
+    pthread_cond_t prefetchCond;
+    int metricsIx;		/*!< index of last element with metrics event */
+};
+
+/**
+ * Package path of an added element, for opening packages natively.
+ */
+struct openPath_s {
+    const void * key;
+    char * path;
 };
 
 /** \ingroup py_c
@@ -214,11 +274,11 @@ rpmts_AddErase(rpmtsObject * s, PyObject * args, PyObject * kwds)
     /* ... otherwise we need to muck with db iterators */
     } else if (PyString_Check(o)) {
 	char * name = PyString_AsString(o);
-	mi = rpmtsInitIterator(s->ts, RPMDBI_LABEL, name, 0);
+	mi = rpmtsDbIterator(s, RPMDBI_LABEL, name, 0);
 	installed = (mi && rpmdbGetIteratorCount(mi) > 1);
     } else if (PyInt_Check(o)) {
 	uint32_t recno = PyInt_AsLong(o);
-	mi = rpmtsInitIterator(s->ts, RPMDBI_PACKAGES, &recno, sizeof(recno));
+	mi = rpmtsDbIterator(s, RPMDBI_PACKAGES, &recno, sizeof(recno));
 	installed = (mi && recno > 0);
     } else {
 	PyErr_SetString(PyExc_TypeError, "header, string or integer expected");
@@ -242,6 +302,289 @@ rpmts_AddErase(rpmtsObject * s, PyObject * args, PyObject * kwds)
     Py_RETURN_NONE;
 }
 
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_AddInstallMany(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * hdrs, * keys = NULL;
+    PyObject * hseq = NULL, * kseq = NULL;
+    char * how = "u";
+    int isUpgrade = 0;
+    char * kwlist[] = {"headers", "keys", "how", NULL};
+    Py_ssize_t i, n, added = 0;
+    int rc = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Os:AddInstallMany", kwlist,
+	    &hdrs, &keys, &how))
+	return NULL;
+
+    if (strcmp(how, "u") && strcmp(how, "i")) {
+	PyErr_SetString(PyExc_ValueError, "how-argument must be one of \"u\" or \"i\"");
+	return NULL;
+    } else if (!strcmp(how, "u"))
+	isUpgrade = 1;
+
+    if ((hseq = PySequence_Fast(hdrs, "headers must be a sequence")) == NULL)
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(hseq);
+    if (keys != NULL && keys != Py_None) {
+	if ((kseq = PySequence_Fast(keys, "keys must be a sequence")) == NULL)
+	    goto exit;
+	if (PySequence_Fast_GET_SIZE(kseq) != n) {
+	    PyErr_SetString(PyExc_ValueError,
+			    "headers and keys differ in length");
+	    goto exit;
+	}
+    }
+
+    /* Validate everything before touching the transaction. */
+    for (i = 0; i < n; i++) {
+	if (!hdrObject_Check(PySequence_Fast_GET_ITEM(hseq, i))) {
+	    PyErr_SetString(PyExc_TypeError, "rpm.hdr objects expected");
+	    goto exit;
+	}
+    }
+
+    debug("(%p,%d,%s) ts %p\n", s, (int) n, how, s->ts);
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < n; i++) {
+	hdrObject * h = (hdrObject *) PySequence_Fast_GET_ITEM(hseq, i);
+	PyObject * key = kseq ? PySequence_Fast_GET_ITEM(kseq, i) : NULL;
+
+	if (key == Py_None)
+	    key = NULL;
+	rc = rpmtsAddInstallElement(s->ts, hdrGetHeader(h), key, isUpgrade, NULL);
+	if (rc)
+	    break;
+	added++;
+    }
+    Py_END_ALLOW_THREADS
+
+    /* Keep the keys of the added elements alive for the transaction. */
+    for (i = 0; kseq != NULL && i < added; i++) {
+	PyObject * key = PySequence_Fast_GET_ITEM(kseq, i);
+	if (key != Py_None)
+	    PyList_Append(s->keyList, key);
+    }
+
+    if (rc)
+	PyErr_Format(pyrpmError, "adding package %d to transaction failed",
+		     (int) added);
+
+exit:
+    Py_XDECREF(kseq);
+    Py_XDECREF(hseq);
+    if (PyErr_Occurred())
+	return NULL;
+    Py_RETURN_NONE;
+}
+
+/**
+ * Above this many distinct names, addEraseMany() matches them in one pass
+ * over all installed headers instead of looking up each name.
+ */
+#define	ERASE_SCAN_MIN	256
+
+/**
+ * Name to erase, looked up in the Name index (or matched in a full pass).
+ */
+struct eraseName_s {
+    const char * name;
+    int found;
+};
+
+static int eraseNameCmp(const void * a, const void * b)
+{
+    const struct eraseName_s * A = a;
+    const struct eraseName_s * B = b;
+    return strcmp(A->name, B->name);
+}
+
+/**
+ * Installed headers collected for erasure.
+ */
+struct eraseSet_s {
+    Header * hdrs;
+    int nhdrs;
+    int nalloced;
+};
+
+static void eraseSetAdd(struct eraseSet_s * es, Header h)
+{
+    if (es->nhdrs == es->nalloced) {
+	es->nalloced = es->nalloced ? 2 * es->nalloced : 64;
+	es->hdrs = xrealloc(es->hdrs, es->nalloced * sizeof(*es->hdrs));
+    }
+    es->hdrs[es->nhdrs++] = headerLink(h);
+}
+
+/**
+ * Add headers matching a single rpmdb lookup to the erase set.
+ * @return		no. of headers found
+ */
+static int eraseSetLookup(rpmtsObject * s, struct eraseSet_s * es,
+		rpmTag tag, const void * key, size_t keylen)
+{
+    rpmdbMatchIterator mi = rpmtsDbIterator(s, tag, key, keylen);
+    Header h, oh = NULL;
+    int found = 0;
+
+    /* mi on recno never terminates, work around for now */
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	if (h == oh) break;
+	eraseSetAdd(es, h);
+	oh = h;
+	found++;
+    }
+    mi = rpmdbFreeIterator(mi);
+    return found;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_AddEraseMany(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * items, * seq;
+    struct eraseName_s * names = NULL;
+    struct eraseSet_s es = { NULL, 0, 0 };
+    uint32_t * recnos = NULL;
+    const char * missing = NULL;
+    int nnames = 0, nrecnos = 0;
+    int ndistinct = 0;
+    int missingRecno = 0;
+    char * kwlist[] = {"items", NULL};
+    Py_ssize_t i, n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:AddEraseMany", kwlist,
+	    &items))
+	return NULL;
+
+    if ((seq = PySequence_Fast(items, "items must be a sequence")) == NULL)
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    names = xcalloc(n + 1, sizeof(*names));
+    recnos = xcalloc(n + 1, sizeof(*recnos));
+    for (i = 0; i < n; i++) {
+	PyObject * o = PySequence_Fast_GET_ITEM(seq, i);
+
+	if (hdrObject_Check(o)) {
+	    Header h = hdrGetHeader((hdrObject *) o);
+	    if (headerGetInstance(h) == 0) {
+		PyErr_SetString(pyrpmError, "package not installed");
+		goto exit;
+	    }
+	    eraseSetAdd(&es, h);
+	} else if (PyString_Check(o)) {
+	    names[nnames++].name = PyString_AsString(o);
+	} else if (PyInt_Check(o)) {
+	    recnos[nrecnos++] = PyInt_AsLong(o);
+	} else {
+	    PyErr_SetString(PyExc_TypeError, "header, string or integer expected");
+	    goto exit;
+	}
+    }
+
+    debug("(%p) ts %p %d names %d recnos\n", s, s->ts, nnames, nrecnos);
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < nrecnos; i++) {
+	if (recnos[i] == 0 || eraseSetLookup(s, &es, RPMDBI_PACKAGES,
+				&recnos[i], sizeof(recnos[i])) == 0) {
+	    missingRecno = recnos[i] ? recnos[i] : -1;
+	    break;
+	}
+    }
+
+    if (!missingRecno && nnames > 0) {
+	qsort(names, nnames, sizeof(*names), eraseNameCmp);
+	for (i = 0; i < nnames; i++) {
+	    if (i == 0 || strcmp(names[i-1].name, names[i].name))
+		ndistinct++;
+	}
+
+	/* Few names: index lookups only load the headers to erase. */
+	for (i = 0; ndistinct <= ERASE_SCAN_MIN && i < nnames; i++) {
+	    /* Duplicate names in the sequence share a single erase. */
+	    if (i > 0 && !strcmp(names[i-1].name, names[i].name))
+		continue;
+	    if (eraseSetLookup(s, &es, RPMTAG_NAME, names[i].name, 0))
+		names[i].found = 1;
+	}
+    }
+
+    if (!missingRecno && nnames > 0 && ndistinct > ERASE_SCAN_MIN) {
+	rpmdbMatchIterator mi;
+	Header h;
+
+	/* Many names: one pass over the rpmdb beats a lookup per name. */
+	mi = rpmtsDbIterator(s, RPMDBI_PACKAGES, NULL, 0);
+	while ((h = rpmdbNextIterator(mi)) != NULL) {
+	    struct eraseName_s needle, * match;
+	    const char * name = NULL;
+
+	    (void) headerNVR(h, &name, NULL, NULL);
+	    if (name == NULL)
+		continue;
+	    needle.name = name;
+	    match = bsearch(&needle, names, nnames, sizeof(*names),
+			    eraseNameCmp);
+	    if (match == NULL)
+		continue;
+	    /* Duplicate names in the sequence share a single erase. */
+	    while (match > names && !strcmp(match[-1].name, name))
+		match--;
+	    match->found = 1;
+	    eraseSetAdd(&es, h);
+	}
+	mi = rpmdbFreeIterator(mi);
+    }
+
+    if (!missingRecno && nnames > 0) {
+	/* Names that matched nothing may be N-V-R labels. */
+	for (i = 0; i < nnames; i++) {
+	    if (names[i].found)
+		continue;
+	    if (i > 0 && !strcmp(names[i-1].name, names[i].name)
+	     && names[i-1].found) {
+		names[i].found = 1;
+		continue;
+	    }
+	    if (eraseSetLookup(s, &es, RPMDBI_LABEL, names[i].name, 0)) {
+		names[i].found = 1;
+	    } else {
+		missing = names[i].name;
+		break;
+	    }
+	}
+    }
+
+    if (!missingRecno && missing == NULL) {
+	for (i = 0; i < es.nhdrs; i++)
+	    rpmtsAddEraseElement(s->ts, es.hdrs[i], -1);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (missingRecno)
+	PyErr_Format(pyrpmError, "package not installed: %d", missingRecno);
+    else if (missing)
+	PyErr_Format(pyrpmError, "package not installed: %s", missing);
+
+exit:
+    for (i = 0; i < es.nhdrs; i++)
+	headerFree(es.hdrs[i]);
+    free(es.hdrs);
+    free(names);
+    free(recnos);
+    Py_DECREF(seq);
+    if (PyErr_Occurred())
+	return NULL;
+    Py_RETURN_NONE;
+}
+
 /** \ingroup py_c
  */
 static int
@@ -257,6 +600,15 @@ rpmts_SolveCallback(rpmts ts, rpmds ds, const void * data)
     if (cbInfo->pythonError) return res;
     if (cbInfo->cb == Py_None) return res;
 
+    /* Batch mode: collect (deduplicated) without taking the GIL. */
+    if (cbInfo->batch) {
+	rpmds one = rpmdsSingle(rpmdsTagN(ds), rpmdsN(ds), rpmdsEVR(ds),
+				rpmdsFlags(ds));
+	(void) rpmdsMerge(&cbInfo->unresolved, one);
+	one = rpmdsFree(one);
+	return res;
+    }
+
     PyEval_RestoreThread(cbInfo->_save);
 
     args = Py_BuildValue("(Oissi)", cbInfo->tso,
@@ -277,94 +629,172 @@ rpmts_SolveCallback(rpmts ts, rpmds ds, const void * data)
     return res;
 }
 
+/**
+ * Hand the unresolved dependencies collected during a check to Python
+ * in a single call.
+ * @return		1 if the callback asks for the check to be re-run
+ */
+static int rpmtsSolveBatch(struct rpmtsCallbackType_s * cbInfo)
+{
+    PyObject * list, * args, * result;
+    rpmds ds = cbInfo->unresolved;
+    int rerun = 0;
+
+    list = PyList_New(0);
+    ds = rpmdsInit(ds);
+    while (rpmdsNext(ds) >= 0) {
+	PyObject * o = rpmds_Wrap(rpmdsSingle(rpmdsTagN(ds), rpmdsN(ds),
+					      rpmdsEVR(ds), rpmdsFlags(ds)));
+	PyList_Append(list, o);
+	Py_DECREF(o);
+    }
+    cbInfo->unresolved = rpmdsFree(cbInfo->unresolved);
+
+    args = Py_BuildValue("(OO)", cbInfo->tso, list);
+    result = PyEval_CallObject(cbInfo->cb, args);
+    Py_DECREF(args);
+    Py_DECREF(list);
+
+    if (!result) {
+	cbInfo->pythonError = 1;
+    } else {
+	rerun = PyObject_IsTrue(result) > 0;
+	Py_DECREF(result);
+    }
+    return rerun;
+}
+
+/**
+ * Hand the unresolved dependencies collected during an incremental check
+ * to Python one at a time, as rpmtsCheck() does.
+ * @return		1 unless the callback failed
+ */
+static int rpmtsSolveEach(struct rpmtsCallbackType_s * cbInfo)
+{
+    rpmds ds = rpmdsInit(cbInfo->unresolved);
+
+    while (rpmdsNext(ds) >= 0 && !cbInfo->pythonError) {
+	PyObject * args, * result;
+
+	args = Py_BuildValue("(Oissi)", cbInfo->tso,
+		rpmdsTagN(ds), rpmdsN(ds), rpmdsEVR(ds), rpmdsFlags(ds));
+	result = PyEval_CallObject(cbInfo->cb, args);
+	Py_DECREF(args);
+	if (!result)
+	    cbInfo->pythonError = 1;
+	Py_XDECREF(result);
+    }
+    cbInfo->unresolved = rpmdsFree(cbInfo->unresolved);
+    return !cbInfo->pythonError;
+}
+
 /** \ingroup py_c
  */
 static PyObject *
 rpmts_Check(rpmtsObject * s, PyObject * args, PyObject * kwds)
 {
     rpmps ps;
-    rpmProblem p;
-    PyObject * list, * cf;
+    PyObject * list;
+    PyObject * batch = NULL;
+    PyObject * incremental = NULL;
     struct rpmtsCallbackType_s cbInfo;
-    int i;
+    int nelements;
+    int rerun;
+    int incr = 0;
     int xx;
-    char * kwlist[] = {"callback", NULL};
+    char * kwlist[] = {"callback", "batch", "incremental", NULL};
 
     memset(&cbInfo, 0, sizeof(cbInfo));
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:Check", kwlist,
-	    &cbInfo.cb))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOO:Check", kwlist,
+	    &cbInfo.cb, &batch, &incremental))
 	return NULL;
 
+    if (incremental != NULL && PyObject_IsTrue(incremental))
+	incr = 1;
+
     if (cbInfo.cb != NULL) {
 	if (!PyCallable_Check(cbInfo.cb)) {
 	    PyErr_SetString(PyExc_TypeError, "expected a callable");
 	    return NULL;
 	}
-	xx = rpmtsSetSolveCallback(s->ts, rpmts_SolveCallback, (void *)&cbInfo);
+	if (batch != NULL && PyObject_IsTrue(batch))
+	    cbInfo.batch = 1;
+	if (!incr)
+	    xx = rpmtsSetSolveCallback(s->ts, rpmts_SolveCallback, (void *)&cbInfo);
     }
 
     debug("(%p) ts %p cb %p\n", s, s->ts, cbInfo.cb);
 
     cbInfo.tso = s;
     cbInfo.pythonError = 0;
-    cbInfo._save = PyEval_SaveThread();
 
-    xx = rpmtsCheck(s->ts);
-    ps = rpmtsProblems(s->ts);
+    do {
+	nelements = rpmtsNElements(s->ts);
+	cbInfo._save = PyEval_SaveThread();
 
-    PyEval_RestoreThread(cbInfo._save);
+	if (incr) {
+	    /* Unresolved requires are collected, then handed to Python. */
+	    ps = rpmcheckRun(&s->check, s,
+			     cbInfo.cb ? &cbInfo.unresolved : NULL);
+	    if (ps == NULL)
+		ps = rpmpsCreate();
+	} else {
+	    xx = rpmtsCheck(s->ts);
+	    ps = rpmtsProblems(s->ts);
+	}
+
+	PyEval_RestoreThread(cbInfo._save);
+
+	/* ts.problems() reports the problems of the last check */
+	s->checkProbs = rpmpsFree(s->checkProbs);
+	if (incr)
+	    s->checkProbs = rpmpsLink(ps, "rpmts_Check");
+
+	/* Re-run only if the callback added elements to resolve with. */
+	rerun = 0;
+	if (cbInfo.unresolved != NULL && !cbInfo.pythonError) {
+	    if (cbInfo.batch)
+		rerun = rpmtsSolveBatch(&cbInfo);
+	    else
+		rerun = rpmtsSolveEach(&cbInfo);
+	    rerun = rerun && rpmtsNElements(s->ts) > nelements;
+	}
+	cbInfo.unresolved = rpmdsFree(cbInfo.unresolved);
+	if (rerun)
+	    ps = rpmpsFree(ps);
+    } while (rerun);
+
+    if (cbInfo.pythonError) {
+	ps = rpmpsFree(ps);
+	return NULL;
+    }
 
     if (ps != NULL) {
-	list = PyList_New(0);
 	rpmpsi psi = rpmpsInitIterator(ps);
+	int i = 0;
 
-	/* XXX TODO: rpmlib >= 4.0.3 can return multiple suggested keys. */
-	while ((i = rpmpsNextIterator(psi)) >= 0) {
-	    char * altNEVR, * needsName;
-	    char * byName, * byVersion, * byRelease, *byArch;
-	    char * needsOP, * needsVersion;
-	    rpmsenseFlags needsFlags, sense;
-	    fnpyKey key;
-
-	    p = rpmpsGetProblem(psi);
-
-	    byName = strdup(rpmProblemGetPkgNEVR(p));
-	    if ((byArch= strrchr(byName, '.')) != NULL)
-		*byArch++ = '\0';
-	    if ((byRelease = strrchr(byName, '-')) != NULL)
-		*byRelease++ = '\0';
-	    if ((byVersion = strrchr(byName, '-')) != NULL)
-		*byVersion++ = '\0';
-
-	    key = rpmProblemGetKey(p);
-
-	    altNEVR = needsName = xstrdup(rpmProblemGetAltNEVR(p));
-	    if (needsName[1] == ' ') {
-		sense = (needsName[0] == 'C')
-			? RPMDEP_SENSE_CONFLICTS : RPMDEP_SENSE_REQUIRES;
-		needsName += 2;
-	    } else
-		sense = RPMDEP_SENSE_REQUIRES;
-	    if ((needsVersion = strrchr(needsName, ' ')) != NULL)
-		*needsVersion++ = '\0';
-
-	    needsFlags = 0;
-	    if ((needsOP = strrchr(needsName, ' ')) != NULL) {
-		for (*needsOP++ = '\0'; *needsOP != '\0'; needsOP++) {
-		    if (*needsOP == '<')	needsFlags |= RPMSENSE_LESS;
-		    else if (*needsOP == '>')	needsFlags |= RPMSENSE_GREATER;
-		    else if (*needsOP == '=')	needsFlags |= RPMSENSE_EQUAL;
-		}
+	/* problem objects look their fields up only when accessed */
+	list = PyList_New(0);
+	while (list != NULL && rpmpsNextIterator(psi) >= 0) {
+	    rpmProblem p = rpmpsGetProblem(psi);
+	    PyObject * prob;
+	    unsigned int inst = 0;
+	    rpmte te = NULL;
+	    rpmds dep = NULL;
+
+	    /* rpmtsCheck() keeps no origin, its problems split the strings */
+	    if (incr)
+		dep = rpmcheckProblem(s->check, i, &te, &inst);
+	    i++;
+
+	    prob = rpmProblem_Wrap(ps, p, (PyObject *) s, te, inst, dep);
+	    if (prob == NULL || PyList_Append(list, prob)) {
+		Py_XDECREF(prob);
+		Py_DECREF(list);
+		list = NULL;
+		break;
 	    }
-
-	    cf = Py_BuildValue("((sss)(ss)iOi)", byName, byVersion, byRelease,
-			       needsName, needsVersion, needsFlags,
-			       (key != NULL ? key : Py_None),
-			       sense);
-	    PyList_Append(list, (PyObject *) cf);
-	    Py_DECREF(cf);
-	    free(byName);
-	    free(altNEVR);
+	    Py_DECREF(prob);
 	}
 
 	psi = rpmpsFreeIterator(psi);
@@ -385,6 +815,8 @@ rpmts_Order(rpmtsObject * s)
 
     debug("(%p) ts %p\n", s, s->ts);
 
+    /* reordered elements are checked from scratch next time */
+    s->check = rpmcheckFree(s->check);
     Py_BEGIN_ALLOW_THREADS
     rc = rpmtsOrder(s->ts);
     Py_END_ALLOW_THREADS
@@ -392,6 +824,72 @@ rpmts_Order(rpmtsObject * s)
     return Py_BuildValue("i", rc);
 }
 
+/**
+ * Transaction set operation statistics, by name.
+ */
+static const struct rpmtsStat_s {
+    rpmtsOpX opx;
+    const char * name;
+} rpmtsStats[] = {
+    { RPMTS_OP_TOTAL,		"total" },
+    { RPMTS_OP_CHECK,		"check" },
+    { RPMTS_OP_ORDER,		"order" },
+    { RPMTS_OP_FINGERPRINT,	"fingerprint" },
+    { RPMTS_OP_REPACKAGE,	"repackage" },
+    { RPMTS_OP_INSTALL,		"install" },
+    { RPMTS_OP_ERASE,		"erase" },
+    { RPMTS_OP_SCRIPTLETS,	"scriptlets" },
+    { RPMTS_OP_COMPRESS,	"compress" },
+    { RPMTS_OP_UNCOMPRESS,	"uncompress" },
+    { RPMTS_OP_DIGEST,		"digest" },
+    { RPMTS_OP_SIGNATURE,	"signature" },
+    { RPMTS_OP_DBADD,		"dbadd" },
+    { RPMTS_OP_DBREMOVE,	"dbremove" },
+    { RPMTS_OP_DBGET,		"dbget" },
+    { RPMTS_OP_DBPUT,		"dbput" },
+    { RPMTS_OP_DBDEL,		"dbdel" },
+    { 0, NULL }
+};
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_Stats(rpmtsObject * s)
+{
+    const struct rpmtsStat_s * st;
+    PyObject * dict = PyDict_New();
+
+    for (st = rpmtsStats; st->name != NULL; st++) {
+	rpmop op = rpmtsOp(s->ts, st->opx);
+	PyObject * o;
+
+	if (op == NULL)
+	    continue;
+	o = Py_BuildValue("{s:i,s:K,s:K}",
+			  "count", op->count,
+			  "usecs", (unsigned PY_LONG_LONG) op->usecs,
+			  "bytes", (unsigned PY_LONG_LONG) op->bytes);
+	PyDict_SetItemString(dict, st->name, o);
+	Py_DECREF(o);
+    }
+    return dict;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_ResetStats(rpmtsObject * s)
+{
+    const struct rpmtsStat_s * st;
+
+    for (st = rpmtsStats; st->name != NULL; st++) {
+	rpmop op = rpmtsOp(s->ts, st->opx);
+	if (op != NULL)
+	    memset(op, 0, sizeof(*op));
+    }
+    Py_RETURN_NONE;
+}
+
 /** \ingroup py_c
  */
 static PyObject *
@@ -399,6 +897,9 @@ rpmts_Clean(rpmtsObject * s)
 {
     debug("(%p) ts %p\n", s, s->ts);
 
+    /* the checker indexes the dependency sets freed here */
+    s->check = rpmcheckFree(s->check);
+    s->checkProbs = rpmpsFree(s->checkProbs);
     rpmtsClean(s->ts);
 
     Py_RETURN_NONE;
@@ -482,6 +983,35 @@ rpmts_VerifyDB(rpmtsObject * s)
     return Py_BuildValue("i", rc);
 }
 
+/**
+ * Return the fingerprint of the keyring packages are verified against.
+ * A keyring set with ts.setKeyring() is known by the keys added to it,
+ * the default one by the rpmdb gpg-pubkeys. Those are fingerprinted
+ * again whenever the rpmdb has changed, so that verifications against
+ * removed or revoked keys stop being reused.
+ */
+static uint64_t rpmtsKeyringId(rpmtsObject * s)
+{
+    rpmKeyringObject * ko = (rpmKeyringObject *) s->keyring;
+    char * pkgpath;
+
+    if (s->vcacheKeyring)
+	return s->vcacheKeyring;
+    if (ko && !ko->fromdb)
+	return ko->keyid;
+
+    pkgpath = rpmGenPath(rpmtsRootDir(s->ts), "%{_dbpath}", "Packages");
+    if (rpmdbStampCheck(pkgpath, &s->dbKeyringStamp, 1)) {
+	Py_BEGIN_ALLOW_THREADS
+	s->dbKeyring = rpmvcacheKeyringId(
+		rpmtsDbIterator(s, RPMTAG_NAME, "gpg-pubkey", 0));
+	Py_END_ALLOW_THREADS
+    }
+    free(pkgpath);
+
+    return ko ? (s->dbKeyring ^ ko->keyid) : s->dbKeyring;
+}
+
 /** \ingroup py_c
  */
 static PyObject *
@@ -492,18 +1022,36 @@ rpmts_HdrFromFdno(rpmtsObject * s, PyObject * args, PyObject * kwds)
     Header h;
     FD_t fd;
     rpmRC rpmrc;
-    char * kwlist[] = {"fd", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:HdrFromFdno", kwlist,
-	    &fo))
+    struct rpmvcacheKey_s key;
+    rpmVSFlags ovsflags = rpmtsVSFlags(s->ts);
+    int useCache = 1;
+    int cached = -1;
+    char * kwlist[] = {"fd", "useCache", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i:HdrFromFdno", kwlist,
+	    &fo, &useCache))
     	return NULL;
 
     if ((fd = rpmFdFromPyObject(fo)) == NULL)
 	return NULL;
 
+    /* Files verified before (and unchanged since) skip signature checks. */
+    if (s->vcache && useCache
+     && !rpmvcacheKey(Fileno(fd), ovsflags, rpmtsKeyringId(s), &key)) {
+	cached = rpmvcacheLookup(s->vcache, &key);
+	if (cached)
+	    (void) rpmtsSetVSFlags(s->ts, ovsflags |
+				   _RPMVSF_NODIGESTS | _RPMVSF_NOSIGNATURES);
+    }
+
     rpmrc = rpmReadPackageFile(s->ts, fd, "rpmts_HdrFromFdno", &h);
     Fclose(fd);
 
+    if (cached == 1)
+	(void) rpmtsSetVSFlags(s->ts, ovsflags);
+    else if (cached == 0 && rpmrc == RPMRC_OK)
+	rpmvcacheAdd(s->vcache, &key);
+
     debug("(%p) ts %p rc %d\n", s, s->ts, rpmrc);
 
     switch (rpmrc) {
@@ -531,84 +1079,379 @@ rpmts_HdrFromFdno(rpmtsObject * s, PyObject * args, PyObject * kwds)
     return result;
 }
 
-/** \ingroup py_c
+/**
+ * Shared state of ts.verifyPackages() workers.
  */
-static PyObject *
-rpmts_HdrCheck(rpmtsObject * s, PyObject * args, PyObject * kwds)
-{
-    PyObject * blob;
-    PyObject * result = NULL;
-    char * msg = NULL;
-    const void * uh;
-    int uc;
-    rpmRC rpmrc;
-    char * kwlist[] = {"headers", NULL};
-
-    debug("(%p) ts %p\n", s, s->ts);
+struct verifyPkgs_s {
+    char ** paths;
+    rpmts * tss;		/*!< per worker transaction sets */
+    Header * hdrs;
+    rpmRC * rcs;
+    int * errnos;		/*!< open failures */
+    rpmvcache vcache;		/*!< verification cache (or NULL) */
+    uint64_t keyring;		/*!< fingerprint of the keyring */
+    rpmVSFlags vsflags;
+};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:HdrCheck", kwlist, &blob))
-    	return NULL;
+/**
+ * rpmReadPackageFile() isn't thread safe (it stashes the key ids of
+ * signatures in unlocked static arrays, and rpmlog keeps no lock either):
+ * the workers read and check the packages one at a time.
+ */
+static pthread_mutex_t verifyReadLock = PTHREAD_MUTEX_INITIALIZER;
 
-    if (blob == Py_None) {
-	Py_RETURN_NONE;
-    }
-    if (!PyString_Check(blob)) {
-	PyErr_SetString(PyExc_TypeError, "string of octets expected");
-	return result;
+static void verifyPackage(void * data, int worker, int ix)
+{
+    struct verifyPkgs_s * vp = data;
+    FD_t fd = Fopen(vp->paths[ix], "r.ufdio");
+    struct rpmvcacheKey_s key;
+    int cached = -1;
+    int omask;
+
+    if (fd == NULL || Ferror(fd)) {
+	vp->errnos[ix] = errno ? errno : EIO;
+	vp->rcs[ix] = RPMRC_FAIL;
+	if (fd)
+	    Fclose(fd);
+	return;
     }
-    uh = PyString_AsString(blob);
-    uc = PyString_Size(blob);
+    if (vp->vcache
+     && !rpmvcacheKey(Fileno(fd), vp->vsflags, vp->keyring, &key))
+	cached = rpmvcacheLookup(vp->vcache, &key);
+    (void) rpmtsSetVSFlags(vp->tss[worker], (cached == 1) ?
+	vp->vsflags | _RPMVSF_NODIGESTS | _RPMVSF_NOSIGNATURES : vp->vsflags);
+
+    /* Get the disk reading while waiting for the lock. */
+    (void) posix_fadvise(Fileno(fd), 0, 0, POSIX_FADV_WILLNEED);
+
+    /*
+     * Verify failures aren't logged, the results carry them. The mask
+     * is process wide: it is changed and restored under the lock, so it
+     * never outlives a read.
+     */
+    pthread_mutex_lock(&verifyReadLock);
+    omask = rpmlogSetMask(RPMLOG_UPTO(RPMLOG_EMERG));
+    vp->rcs[ix] = rpmReadPackageFile(vp->tss[worker], fd, vp->paths[ix],
+				     &vp->hdrs[ix]);
+    (void) rpmlogSetMask(omask);
+    pthread_mutex_unlock(&verifyReadLock);
+    Fclose(fd);
 
-    rpmrc = headerCheck(s->ts, uh, uc, &msg);
+    if (cached == 0 && vp->rcs[ix] == RPMRC_OK)
+	rpmvcacheAdd(vp->vcache, &key);
+}
 
-    switch (rpmrc) {
+/**
+ * Build the result dict of a verified package.
+ */
+static PyObject * verifyResult(struct verifyPkgs_s * vp, int ix, int headers)
+{
+    PyObject * res, * o;
+    const char * msg = NULL;
+
+    switch (vp->rcs[ix]) {
     case RPMRC_OK:
-	Py_INCREF(Py_None);
-	result = Py_None;
 	break;
-
     case RPMRC_NOKEY:
-	PyErr_SetString(pyrpmError, "public key not availaiable");
+	msg = "public key not available";
 	break;
-
     case RPMRC_NOTTRUSTED:
-	PyErr_SetString(pyrpmError, "public key not trusted");
+	msg = "public key not trusted";
 	break;
-
+    case RPMRC_NOTFOUND:
     case RPMRC_FAIL:
     default:
-	PyErr_SetString(pyrpmError, msg);
+	msg = vp->errnos[ix] ? strerror(vp->errnos[ix])
+			     : "error reading package header";
 	break;
     }
-    free(msg);
 
-    return result;
+    res = PyDict_New();
+    o = PyString_FromString(vp->paths[ix]);
+    PyDict_SetItemString(res, "path", o);
+    Py_DECREF(o);
+    o = PyInt_FromLong(vp->rcs[ix]);
+    PyDict_SetItemString(res, "rc", o);
+    Py_DECREF(o);
+    if (msg) {
+	o = PyString_FromString(msg);
+	PyDict_SetItemString(res, "error", o);
+	Py_DECREF(o);
+    } else
+	PyDict_SetItemString(res, "error", Py_None);
+    if (headers) {
+	if (vp->hdrs[ix]) {
+	    o = hdr_Wrap(vp->hdrs[ix]);
+	    PyDict_SetItemString(res, "header", o);
+	    Py_DECREF(o);
+	} else
+	    PyDict_SetItemString(res, "header", Py_None);
+    }
+    vp->hdrs[ix] = headerFree(vp->hdrs[ix]);
+    return res;
 }
 
-/** \ingroup py_c
- */
-static PyObject *
-rpmts_SetVSFlags(rpmtsObject * s, PyObject * args, PyObject * kwds)
+void rpmtsCopyKeyring(rpmtsObject * s, rpmts wts)
 {
-    rpmVSFlags vsflags;
-    char * kwlist[] = {"flags", NULL};
-
-    debug("(%p) ts %p\n", s, s->ts);
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i:SetVSFlags", kwlist,
-	    &vsflags))
-    	return NULL;
-
-    /* XXX FIXME: value check on vsflags, or build pure python object 
-     * for it, and require an object of that type */
-
-    return Py_BuildValue("i", rpmtsSetVSFlags(s->ts, vsflags));
+    rpmKeyringObject * ko = (rpmKeyringObject *) s->keyring;
+    rpmKeyring keyring;
+    Py_ssize_t i;
+
+    if (ko == NULL || ko->fromdb) {
+	/* load the rpmdb gpg-pubkeys, then let go of the rpmdb again */
+	keyring = rpmtsGetKeyring(wts, 1);
+	(void) rpmtsCloseDB(wts);
+    } else {
+	keyring = rpmKeyringNew();
+	(void) rpmtsSetKeyring(wts, keyring);
+    }
+    for (i = 0; ko != NULL && i < PyList_GET_SIZE(ko->keys); i++) {
+	rpmPubkeyObject * po = (rpmPubkeyObject *) PyList_GET_ITEM(ko->keys, i);
+	(void) rpmKeyringAddKey(keyring, po->pubkey);
+    }
+    keyring = rpmKeyringFree(keyring);
 }
 
 /** \ingroup py_c
  */
 static PyObject *
-rpmts_GetVSFlags(rpmtsObject * s)
+rpmts_VerifyPackages(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * paths, * seq;
+    PyObject * callback = NULL;
+    PyObject * result = NULL;
+    struct verifyPkgs_s vp;
+    rpmpool pool = NULL;
+    int workers = 0;
+    int vsflags = -1;
+    int headers = 0;
+    int useCache = 1;
+    int i, n, nworkers = 0;
+    char * kwlist[] = {"paths", "workers", "vsflags", "headers", "callback",
+		       "useCache", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiiOi:VerifyPackages",
+	    kwlist, &paths, &workers, &vsflags, &headers, &callback, &useCache))
+	return NULL;
+
+    if (callback == Py_None)
+	callback = NULL;
+    if (callback != NULL && !PyCallable_Check(callback)) {
+	PyErr_SetString(PyExc_TypeError, "expected a callable");
+	return NULL;
+    }
+    if ((seq = PySequence_Fast(paths, "paths must be a sequence")) == NULL)
+	return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    memset(&vp, 0, sizeof(vp));
+    vp.paths = xcalloc(n + 1, sizeof(*vp.paths));
+    for (i = 0; i < n; i++) {
+	PyObject * o = PySequence_Fast_GET_ITEM(seq, i);
+	if (!PyString_Check(o)) {
+	    PyErr_SetString(PyExc_TypeError, "paths must be strings");
+	    goto exit;
+	}
+	vp.paths[i] = xstrdup(PyString_AsString(o));
+    }
+
+    if (workers <= 0)
+	workers = rpmpoolDefaultWorkers();
+    nworkers = (workers < n) ? workers : n;
+    if (nworkers < 1)
+	nworkers = 1;
+    if (vsflags == -1)
+	vsflags = rpmtsVSFlags(s->ts);
+    vp.vsflags = vsflags;
+    vp.vcache = useCache ? s->vcache : NULL;
+    if (vp.vcache)
+	vp.keyring = rpmtsKeyringId(s);
+
+    /* Each worker gets its own ts and keyring. */
+    vp.tss = xcalloc(nworkers, sizeof(*vp.tss));
+    for (i = 0; i < nworkers; i++) {
+	vp.tss[i] = rpmtsCreate();
+	(void) rpmtsSetRootDir(vp.tss[i], rpmtsRootDir(s->ts));
+	rpmtsCopyKeyring(s, vp.tss[i]);
+    }
+
+    vp.hdrs = xcalloc(n + 1, sizeof(*vp.hdrs));
+    vp.rcs = xcalloc(n + 1, sizeof(*vp.rcs));
+    vp.errnos = xcalloc(n + 1, sizeof(*vp.errnos));
+
+    debug("(%p) ts %p %d paths %d workers\n", s, s->ts, n, nworkers);
+
+    if (n > 0 && (pool = rpmpoolNew(nworkers, n, verifyPackage, &vp)) == NULL) {
+	PyErr_SetString(pyrpmError, "cannot start verification threads");
+	goto exit;
+    }
+
+    /* Hand back results in order while the workers continue. */
+    if (callback == NULL)
+	result = PyList_New(0);
+    for (i = 0; i < n; i++) {
+	PyObject * res;
+	int rc;
+
+	Py_BEGIN_ALLOW_THREADS
+	rc = rpmpoolWait(pool, i);
+	Py_END_ALLOW_THREADS
+	if (rc)
+	    break;
+
+	res = verifyResult(&vp, i, headers);
+	if (callback) {
+	    PyObject * r = PyObject_CallFunctionObjArgs(callback, res, NULL);
+	    Py_DECREF(res);
+	    if (r == NULL) {
+		rpmpoolCancel(pool);
+		break;
+	    }
+	    Py_DECREF(r);
+	} else {
+	    PyList_Append(result, res);
+	    Py_DECREF(res);
+	}
+    }
+
+exit:
+    Py_BEGIN_ALLOW_THREADS
+    pool = rpmpoolFree(pool);
+    Py_END_ALLOW_THREADS
+
+    for (i = 0; i < n; i++) {
+	free(vp.paths[i]);
+	if (vp.hdrs)
+	    headerFree(vp.hdrs[i]);
+    }
+    for (i = 0; vp.tss && i < nworkers; i++)
+	rpmtsFree(vp.tss[i]);
+    free(vp.tss);
+    free(vp.paths);
+    free(vp.hdrs);
+    free(vp.rcs);
+    free(vp.errnos);
+    Py_DECREF(seq);
+
+    if (PyErr_Occurred()) {
+	Py_XDECREF(result);
+	return NULL;
+    }
+    if (result == NULL)
+	Py_RETURN_NONE;
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_SetVerifyCache(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    char * path = NULL;
+    char * keyringId = NULL;
+    char * kwlist[] = {"path", "keyringId", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "z|z:SetVerifyCache", kwlist,
+	    &path, &keyringId))
+	return NULL;
+
+    s->vcache = rpmvcacheFree(s->vcache);
+    s->vcacheKeyring = 0;
+    if (path == NULL)
+	Py_RETURN_NONE;
+
+    if ((s->vcache = rpmvcacheNew(path)) == NULL) {
+	if (errno == EINVAL)
+	    PyErr_Format(pyrpmError, "%s: not a verification cache", path);
+	else
+	    PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+	return NULL;
+    }
+
+    /* Results are only valid for the keyring they were verified with. */
+    if (keyringId != NULL)
+	s->vcacheKeyring = rpmvcacheHash(0, keyringId, strlen(keyringId));
+    Py_RETURN_NONE;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_HdrCheck(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * blob;
+    PyObject * result = NULL;
+    char * msg = NULL;
+    const void * uh;
+    int uc;
+    rpmRC rpmrc;
+    char * kwlist[] = {"headers", NULL};
+
+    debug("(%p) ts %p\n", s, s->ts);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:HdrCheck", kwlist, &blob))
+    	return NULL;
+
+    if (blob == Py_None) {
+	Py_RETURN_NONE;
+    }
+    if (!PyString_Check(blob)) {
+	PyErr_SetString(PyExc_TypeError, "string of octets expected");
+	return result;
+    }
+    uh = PyString_AsString(blob);
+    uc = PyString_Size(blob);
+
+    rpmrc = headerCheck(s->ts, uh, uc, &msg);
+
+    switch (rpmrc) {
+    case RPMRC_OK:
+	Py_INCREF(Py_None);
+	result = Py_None;
+	break;
+
+    case RPMRC_NOKEY:
+	PyErr_SetString(pyrpmError, "public key not availaiable");
+	break;
+
+    case RPMRC_NOTTRUSTED:
+	PyErr_SetString(pyrpmError, "public key not trusted");
+	break;
+
+    case RPMRC_FAIL:
+    default:
+	PyErr_SetString(pyrpmError, msg);
+	break;
+    }
+    free(msg);
+
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_SetVSFlags(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    rpmVSFlags vsflags;
+    char * kwlist[] = {"flags", NULL};
+
+    debug("(%p) ts %p\n", s, s->ts);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i:SetVSFlags", kwlist,
+	    &vsflags))
+    	return NULL;
+
+    /* XXX FIXME: value check on vsflags, or build pure python object 
+     * for it, and require an object of that type */
+
+    return Py_BuildValue("i", rpmtsSetVSFlags(s->ts, vsflags));
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_GetVSFlags(rpmtsObject * s)
 {
     return Py_BuildValue("i", rpmtsVSFlags(s->ts));
 }
@@ -728,6 +1571,343 @@ rpmts_GetKeys(rpmtsObject * s)
     return tuple;
 }
 
+/**
+ * Collect package paths of added elements in transaction order.
+ * @return		0 on success, -1 (with exception set) on non-path keys
+ */
+static int rpmtsCollectPaths(rpmtsObject * s,
+		struct rpmtsCallbackType_s * cbInfo)
+{
+    int nelements = rpmtsNElements(s->ts);
+    int i;
+
+    cbInfo->paths = xcalloc(nelements + 1, sizeof(*cbInfo->paths));
+    cbInfo->npaths = 0;
+    for (i = 0; i < nelements; i++) {
+	rpmte te = rpmtsElement(s->ts, i);
+	PyObject * key;
+
+	if (rpmteType(te) != TR_ADDED)
+	    continue;
+	key = (PyObject *) rpmteKey(te);
+	if (key == NULL || !PyString_Check(key)) {
+	    PyErr_SetString(PyExc_TypeError,
+			    "openKeys requires package paths as keys");
+	    return -1;
+	}
+	cbInfo->paths[cbInfo->npaths].key = key;
+	cbInfo->paths[cbInfo->npaths].path = xstrdup(PyString_AsString(key));
+	cbInfo->npaths++;
+    }
+    return 0;
+}
+
+static void rpmtsFreePaths(struct rpmtsCallbackType_s * cbInfo)
+{
+    int i;
+
+    if (cbInfo->paths == NULL)
+	return;
+    for (i = 0; i < cbInfo->npaths; i++)
+	free(cbInfo->paths[i].path);
+    free(cbInfo->paths);
+    cbInfo->paths = NULL;
+    cbInfo->npaths = 0;
+}
+
+/**
+ * Readahead thread: ask the kernel to start reading the packages up to
+ * prefetchWanted, so that opening them doesn't wait on the disk.
+ */
+static void * rpmtsReadaheadThread(void * arg)
+{
+    struct rpmtsCallbackType_s * cbInfo = arg;
+
+    pthread_mutex_lock(&cbInfo->prefetchLock);
+    while (!cbInfo->prefetchStop) {
+	int i, pfd;
+
+	if (cbInfo->prefetched >= cbInfo->prefetchWanted) {
+	    pthread_cond_wait(&cbInfo->prefetchCond, &cbInfo->prefetchLock);
+	    continue;
+	}
+	i = cbInfo->prefetched++;
+	pthread_mutex_unlock(&cbInfo->prefetchLock);
+
+	if ((pfd = open(cbInfo->paths[i].path, O_RDONLY)) >= 0) {
+	    (void) posix_fadvise(pfd, 0, 0, POSIX_FADV_WILLNEED);
+	    close(pfd);
+	}
+
+	pthread_mutex_lock(&cbInfo->prefetchLock);
+    }
+    pthread_mutex_unlock(&cbInfo->prefetchLock);
+
+    return NULL;
+}
+
+/**
+ * Start the readahead thread of ts.run(openKeys=True, readahead=n).
+ * Without it packages are just not prefetched.
+ */
+static void rpmtsReadaheadStart(struct rpmtsCallbackType_s * cbInfo)
+{
+    if (cbInfo->paths == NULL || cbInfo->readahead <= 0)
+	return;
+    pthread_mutex_init(&cbInfo->prefetchLock, NULL);
+    pthread_cond_init(&cbInfo->prefetchCond, NULL);
+    if (pthread_create(&cbInfo->prefetchThread, NULL,
+		       rpmtsReadaheadThread, cbInfo) == 0) {
+	cbInfo->prefetchActive = 1;
+    } else {
+	pthread_cond_destroy(&cbInfo->prefetchCond);
+	pthread_mutex_destroy(&cbInfo->prefetchLock);
+    }
+}
+
+static void rpmtsReadaheadStop(struct rpmtsCallbackType_s * cbInfo)
+{
+    if (!cbInfo->prefetchActive)
+	return;
+    pthread_mutex_lock(&cbInfo->prefetchLock);
+    cbInfo->prefetchStop = 1;
+    pthread_cond_signal(&cbInfo->prefetchCond);
+    pthread_mutex_unlock(&cbInfo->prefetchLock);
+    pthread_join(cbInfo->prefetchThread, NULL);
+    pthread_cond_destroy(&cbInfo->prefetchCond);
+    pthread_mutex_destroy(&cbInfo->prefetchLock);
+    cbInfo->prefetchActive = 0;
+}
+
+/**
+ * Open the package of an added element, letting the readahead thread
+ * know which packages come next. Called without the GIL.
+ */
+static FD_t rpmtsOpenPath(struct rpmtsCallbackType_s * cbInfo,
+		const void * key)
+{
+    int n = cbInfo->npaths;
+    int ix = -1;
+    int i;
+    FD_t fd;
+
+    /* Elements are usually opened in order, start at the last one. */
+    for (i = 0; i < n; i++) {
+	int j = (cbInfo->pathIx + i) % n;
+	if (cbInfo->paths[j].key == key) {
+	    ix = j;
+	    break;
+	}
+    }
+    if (ix < 0)
+	return NULL;
+    cbInfo->pathIx = ix;
+
+    if (cbInfo->prefetchActive) {
+	pthread_mutex_lock(&cbInfo->prefetchLock);
+	if (cbInfo->prefetched < ix + 1)
+	    cbInfo->prefetched = ix + 1;
+	cbInfo->prefetchWanted = ix + 1 + cbInfo->readahead;
+	if (cbInfo->prefetchWanted > n)
+	    cbInfo->prefetchWanted = n;
+	pthread_cond_signal(&cbInfo->prefetchCond);
+	pthread_mutex_unlock(&cbInfo->prefetchLock);
+    }
+
+    fd = Fopen(cbInfo->paths[ix].path, "r.ufdio");
+    if (fd != NULL && Ferror(fd)) {
+	Fclose(fd);
+	fd = NULL;
+    }
+    if (fd != NULL)
+	fcntl(Fileno(fd), F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/**
+ * Per element metrics collected during ts.run().
+ */
+struct teMetrics_s {
+    PyObject * key;
+    char * nevra;
+    rpmElementType type;
+    unsigned int dboffset;
+    int started;		/*!< start event seen? */
+    int active;			/*!< between start and stop events? */
+    struct timeval start;
+    rpmtime_t uncompress0, scriptlets0, digest0;
+    uint64_t usecs;
+    uint64_t bytes;
+    uint64_t uncompressUsecs;
+    uint64_t scriptletUsecs;
+    uint64_t digestUsecs;
+};
+
+static rpmtime_t rpmtsOpUsecs(rpmts ts, rpmtsOpX opx)
+{
+    rpmop op = rpmtsOp(ts, opx);
+    return op ? op->usecs : 0;
+}
+
+/**
+ * Set up metrics for all elements of a transaction set.
+ */
+static void rpmtsMetricsInit(rpmtsObject * s)
+{
+    int nelements = rpmtsNElements(s->ts);
+    int i;
+
+    s->metrics = xcalloc(nelements + 1, sizeof(*s->metrics));
+    s->nmetrics = nelements;
+    for (i = 0; i < nelements; i++) {
+	rpmte te = rpmtsElement(s->ts, i);
+	struct teMetrics_s * m = &s->metrics[i];
+
+	m->type = rpmteType(te);
+	m->nevra = xstrdup(rpmteNEVRA(te));
+	m->dboffset = (m->type == TR_REMOVED) ? rpmteDBOffset(te) : 0;
+	m->key = (PyObject *) rpmteKey(te);
+	Py_XINCREF(m->key);
+    }
+}
+
+static void rpmtsMetricsFree(rpmtsObject * s)
+{
+    int i;
+
+    for (i = 0; i < s->nmetrics; i++) {
+	Py_XDECREF(s->metrics[i].key);
+	free(s->metrics[i].nevra);
+    }
+    free(s->metrics);
+    s->metrics = NULL;
+    s->nmetrics = 0;
+}
+
+/**
+ * Account a transaction callback event to its element. Called without
+ * the GIL.
+ */
+static void rpmtsMetricsRecord(struct rpmtsCallbackType_s * cbInfo,
+		Header h, rpmCallbackType what, rpm_loff_t amount,
+		const void * pkgKey)
+{
+    rpmtsObject * s = cbInfo->tso;
+    rpmts ts = s->ts;
+    struct teMetrics_s * m = NULL;
+    unsigned int dboffset = 0;
+    struct timeval now;
+    int n = s->nmetrics;
+    int starting = 0;
+    int i;
+
+    switch (what) {
+    case RPMCALLBACK_INST_OPEN_FILE:
+	starting = 1;
+	/* fallthrough */
+    case RPMCALLBACK_INST_CLOSE_FILE:
+    case RPMCALLBACK_INST_PROGRESS:
+	if (pkgKey == NULL)
+	    return;
+	break;
+    case RPMCALLBACK_UNINST_START:
+	starting = 1;
+	/* fallthrough */
+    case RPMCALLBACK_UNINST_STOP:
+	if (h == NULL || (dboffset = headerGetInstance(h)) == 0)
+	    return;
+	break;
+    default:
+	return;
+    }
+
+    /*
+     * Elements are processed in order, one at a time: start at the last
+     * one. Added elements may share a key, a start event belongs to the
+     * first of them not started yet, other events to the active one.
+     */
+    for (i = 0; i < n; i++) {
+	struct teMetrics_s * c = &s->metrics[(cbInfo->metricsIx + i) % n];
+	if (starting ? c->started : !c->active)
+	    continue;
+	if (dboffset ? (c->type == TR_REMOVED && c->dboffset == dboffset)
+		     : (c->type == TR_ADDED && c->key == pkgKey)) {
+	    m = c;
+	    cbInfo->metricsIx = (cbInfo->metricsIx + i) % n;
+	    break;
+	}
+    }
+    if (m == NULL)
+	return;
+
+    switch (what) {
+    case RPMCALLBACK_INST_PROGRESS:
+	m->bytes = amount;
+	return;
+    case RPMCALLBACK_INST_OPEN_FILE:
+    case RPMCALLBACK_UNINST_START:
+	gettimeofday(&m->start, NULL);
+	m->uncompress0 = rpmtsOpUsecs(ts, RPMTS_OP_UNCOMPRESS);
+	m->scriptlets0 = rpmtsOpUsecs(ts, RPMTS_OP_SCRIPTLETS);
+	m->digest0 = rpmtsOpUsecs(ts, RPMTS_OP_DIGEST);
+	m->started = 1;
+	m->active = 1;
+	return;
+    default:
+	gettimeofday(&now, NULL);
+	m->usecs += (uint64_t) (now.tv_sec - m->start.tv_sec) * 1000000
+		  + (now.tv_usec - m->start.tv_usec);
+	m->uncompressUsecs += rpmtsOpUsecs(ts, RPMTS_OP_UNCOMPRESS) - m->uncompress0;
+	m->scriptletUsecs += rpmtsOpUsecs(ts, RPMTS_OP_SCRIPTLETS) - m->scriptlets0;
+	m->digestUsecs += rpmtsOpUsecs(ts, RPMTS_OP_DIGEST) - m->digest0;
+	m->active = 0;
+	return;
+    }
+}
+
+/**
+ * Decide whether a progress event is suppressed by ts.run() throttling.
+ * Called without the GIL.
+ * @return		1 if the event should not reach python
+ */
+static int rpmtsProgressSkip(struct rpmtsCallbackType_s * cbInfo,
+		rpmCallbackType what, rpm_loff_t amount, rpm_loff_t total)
+{
+    struct timeval now;
+
+    switch (what) {
+    case RPMCALLBACK_INST_PROGRESS:
+    case RPMCALLBACK_UNINST_PROGRESS:
+    case RPMCALLBACK_TRANS_PROGRESS:
+	break;
+    default:
+	/* State change, start throttling afresh. */
+	cbInfo->progressSeen = 0;
+	return 0;
+    }
+
+    if (cbInfo->progressInterval <= 0 && cbInfo->progressBytes == 0)
+	return 0;
+
+    gettimeofday(&now, NULL);
+    if (cbInfo->progressSeen && amount < total) {
+	if (cbInfo->progressBytes > 0 && amount >= cbInfo->lastAmount
+	 && amount - cbInfo->lastAmount < cbInfo->progressBytes)
+	    return 1;
+	if (cbInfo->progressInterval > 0) {
+	    long msecs = (now.tv_sec - cbInfo->lastTime.tv_sec) * 1000
+		       + (now.tv_usec - cbInfo->lastTime.tv_usec) / 1000;
+	    if (msecs >= 0 && msecs < cbInfo->progressInterval)
+		return 1;
+	}
+    }
+
+    cbInfo->progressSeen = 1;
+    cbInfo->lastAmount = amount;
+    cbInfo->lastTime = now;
+    return 0;
+}
+
 /** \ingroup py_c
  */
 static void *
@@ -741,8 +1921,34 @@ rpmtsCallback(const void * hd, const rpmCallbackType what,
     PyObject * args, * result;
     static FD_t fd;
 
-    if (cbInfo->pythonError) return NULL;
-    if (cbInfo->cb == Py_None) return NULL;
+    rpmtsMetricsRecord(cbInfo, h, what, amount, pkgKey);
+
+    if (cbInfo->pythonError) {
+	/* rpm still closes what it opened before the error */
+	if (what == RPMCALLBACK_INST_CLOSE_FILE && fd != NULL) {
+	    Fclose(fd);
+	    fd = NULL;
+	}
+	return NULL;
+    }
+
+    if (what == RPMCALLBACK_INST_OPEN_FILE && cbInfo->paths != NULL) {
+	fd = rpmtsOpenPath(cbInfo, pkgKey);
+	debug("\t%p = rpmtsOpenPath(%p)\n", fd, pkgKey);
+	if (fd == NULL || cbInfo->cb == Py_None)
+	    return fd;
+    }
+
+    if (cbInfo->cb == Py_None) {
+	if (what == RPMCALLBACK_INST_CLOSE_FILE && cbInfo->paths != NULL) {
+	    Fclose(fd);
+	    fd = NULL;
+	}
+	return NULL;
+    }
+    if (rpmtsProgressSkip(cbInfo, what, amount, total)) return NULL;
+
+    PyEval_RestoreThread(cbInfo->_save);
 
     /* Synthesize a python object for callback (if necessary). */
     if (pkgObj == NULL) {
@@ -757,8 +1963,6 @@ rpmtsCallback(const void * hd, const rpmCallbackType what,
     } else
 	Py_INCREF(pkgObj);
 
-    PyEval_RestoreThread(cbInfo->_save);
-
     args = Py_BuildValue("(iLLOO)", what, amount, total, pkgObj, cbInfo->data);
     result = PyEval_CallObject(cbInfo->cb, args);
     Py_DECREF(args);
@@ -767,9 +1971,18 @@ rpmtsCallback(const void * hd, const rpmCallbackType what,
     if (!result) {
 	cbInfo->pythonError = 1;
 	cbInfo->_save = PyEval_SaveThread();
+	if (what == RPMCALLBACK_INST_OPEN_FILE && cbInfo->paths != NULL) {
+	    Fclose(fd);
+	    fd = NULL;
+	}
 	return NULL;
     }
 
+    if (what == RPMCALLBACK_INST_OPEN_FILE && cbInfo->paths != NULL) {
+	Py_DECREF(result);
+	cbInfo->_save = PyEval_SaveThread();
+	return fd;
+    } else
     if (what == RPMCALLBACK_INST_OPEN_FILE) {
 	int fdno;
 
@@ -791,6 +2004,7 @@ rpmtsCallback(const void * hd, const rpmCallbackType what,
     if (what == RPMCALLBACK_INST_CLOSE_FILE) {
         debug("\tFclose(%p)\n", fd);
 	Fclose (fd);
+	fd = NULL;
     } else {
         debug("\t%d:%d key %p\n", amount, total, pkgKey);
     }
@@ -850,6 +2064,8 @@ rpmts_Problems(rpmtsObject * s)
 
     debug("(%p) ts %p\n", s, s->ts);
 
+    if (s->checkProbs != NULL)
+	return rpmps_Wrap( rpmpsLink(s->checkProbs, "rpmts_Problems") );
     return rpmps_Wrap( rpmtsProblems(s->ts) );
 }
 
@@ -863,33 +2079,59 @@ rpmts_Run(rpmtsObject * s, PyObject * args, PyObject * kwds)
     rpmps ps;
     rpmpsi psi;
     struct rpmtsCallbackType_s cbInfo;
-    char * kwlist[] = {"callback", "data", NULL};
+    PY_LONG_LONG progressBytes = 0;
+    PyObject * openKeys = NULL;
+    char * kwlist[] = {"callback", "data", "progressInterval", "progressBytes",
+		       "openKeys", "readahead", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO:Run", kwlist,
-	    &cbInfo.cb, &cbInfo.data))
+    memset(&cbInfo, 0, sizeof(cbInfo));
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|iLOi:Run", kwlist,
+	    &cbInfo.cb, &cbInfo.data, &cbInfo.progressInterval,
+	    &progressBytes, &openKeys, &cbInfo.readahead))
 	return NULL;
 
-    cbInfo.tso = s;
-    cbInfo.pythonError = 0;
-    cbInfo._save = PyEval_SaveThread();
+    if (cbInfo.progressInterval < 0 || progressBytes < 0) {
+	PyErr_SetString(PyExc_ValueError, "progress throttling must be >= 0");
+	return NULL;
+    }
+    cbInfo.progressBytes = progressBytes;
 
-    if (cbInfo.cb != NULL) {
-	if (!PyCallable_Check(cbInfo.cb)) {
-	    PyErr_SetString(PyExc_TypeError, "expected a callable");
+    if (openKeys != NULL && PyObject_IsTrue(openKeys)) {
+	if (rpmtsCollectPaths(s, &cbInfo)) {
+	    rpmtsFreePaths(&cbInfo);
 	    return NULL;
 	}
-	(void) rpmtsSetNotifyCallback(s->ts, rpmtsCallback, (void *) &cbInfo);
     }
 
+    if (cbInfo.cb != Py_None && !PyCallable_Check(cbInfo.cb)) {
+	PyErr_SetString(PyExc_TypeError, "expected a callable");
+	rpmtsFreePaths(&cbInfo);
+	return NULL;
+    }
+
+    /* Metrics are collected natively, with or without a python callback. */
+    rpmtsMetricsFree(s);
+    rpmtsMetricsInit(s);
+    s->check = rpmcheckFree(s->check);
+    s->checkProbs = rpmpsFree(s->checkProbs);
+
+    cbInfo.tso = s;
+    cbInfo.pythonError = 0;
+    cbInfo._save = PyEval_SaveThread();
+
+    (void) rpmtsSetNotifyCallback(s->ts, rpmtsCallback, (void *) &cbInfo);
+    rpmtsReadaheadStart(&cbInfo);
+
     debug("(%p) ts %p ignore %x\n", s, s->ts, s->ignoreSet);
 
     rc = rpmtsRun(s->ts, NULL, s->ignoreSet);
     ps = rpmtsProblems(s->ts);
 
-    if (cbInfo.cb)
-	(void) rpmtsSetNotifyCallback(s->ts, NULL, NULL);
+    rpmtsReadaheadStop(&cbInfo);
+    (void) rpmtsSetNotifyCallback(s->ts, NULL, NULL);
 
     PyEval_RestoreThread(cbInfo._save);
+    rpmtsFreePaths(&cbInfo);
 
     if (cbInfo.pythonError) {
 	ps = rpmpsFree(ps);
@@ -923,6 +2165,31 @@ rpmts_Run(rpmtsObject * s, PyObject * args, PyObject * kwds)
     return list;
 }
 
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_RunStats(rpmtsObject * s)
+{
+    PyObject * list = PyList_New(0);
+    int i;
+
+    for (i = 0; i < s->nmetrics; i++) {
+	struct teMetrics_s * m = &s->metrics[i];
+	PyObject * o = Py_BuildValue("{s:s,s:i,s:O,s:K,s:K,s:K,s:K,s:K}",
+		"nevra", m->nevra,
+		"type", m->type,
+		"key", m->key ? m->key : Py_None,
+		"usecs", (unsigned PY_LONG_LONG) m->usecs,
+		"bytes", (unsigned PY_LONG_LONG) m->bytes,
+		"uncompressUsecs", (unsigned PY_LONG_LONG) m->uncompressUsecs,
+		"scriptletUsecs", (unsigned PY_LONG_LONG) m->scriptletUsecs,
+		"digestUsecs", (unsigned PY_LONG_LONG) m->digestUsecs);
+	PyList_Append(list, o);
+	Py_DECREF(o);
+    }
+    return list;
+}
+
 /**
  * @todo Add TR_ADDED filter to iterator.
  */
@@ -969,6 +2236,12 @@ static PyObject *rpmts_setKeyring(rpmtsObject *self,
     }
 
     rc = rpmtsSetKeyring(self->ts, keyring->keyring);
+    if (rc == 0) {
+	/* the verification cache fingerprints the keys of this one */
+	Py_INCREF(keyring);
+	Py_XDECREF(self->keyring);
+	self->keyring = (PyObject *) keyring;
+    }
 
     return PyInt_FromLong(rc);
 }
@@ -985,6 +2258,475 @@ static PyObject *rpmts_getKeyring(rpmtsObject *self,
     return rpmKeyring_Wrap(rpmtsGetKeyring(self->ts, autoload));
 }
 
+/**
+ * Lazily open the transaction rpmdb O_RDONLY, setting python error on failure.
+ * @return		0 on success
+ */
+static int rpmtsOpenRdb(rpmtsObject * s)
+{
+    if (s->sharedDB) {
+	rpmdb db = rpmdbPoolGet(rpmtsRootDir(s->ts));
+	if (db == NULL) {
+	    PyErr_SetString(pyrpmError, "rpmdb open failed");
+	    return -1;
+	}
+	db = rpmdbPoolPut(db);
+	return 0;
+    }
+
+    /* XXX FIXME: lazy default rdonly open also done by rpmtsInitIterator(). */
+    if (rpmtsGetRdb(s->ts) == NULL) {
+	int rc = rpmtsOpenDB(s->ts, O_RDONLY);
+	if (rc || rpmtsGetRdb(s->ts) == NULL) {
+	    PyErr_SetString(pyrpmError, "rpmdb open failed");
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+rpmdbMatchIterator rpmtsDbIterator(rpmtsObject * s, rpmTag tag,
+		const void * key, size_t keylen)
+{
+    rpmdbMatchIterator mi;
+    rpmdb db;
+
+    if (!s->sharedDB)
+	return rpmtsInitIterator(s->ts, tag, key, keylen);
+
+    /* The iterator holds its own reference to the handle. */
+    db = rpmdbPoolGet(rpmtsRootDir(s->ts));
+    mi = rpmdbInitIterator(db, tag, key, keylen);
+    if (mi && !(rpmtsVSFlags(s->ts) & RPMVSF_NOHDRCHK))
+	(void) rpmdbSetHdrChk(mi, s->ts, headerCheck);
+    db = rpmdbPoolPut(db);
+    return mi;
+}
+
+Header rpmtsInstanceHeader(rpmtsObject * s, unsigned int instance)
+{
+    rpmdbMatchIterator mi;
+    Header h;
+
+    mi = rpmtsDbIterator(s, RPMDBI_PACKAGES, &instance, sizeof(instance));
+    if ((h = rpmdbNextIterator(mi)) != NULL)
+	h = headerLink(h);
+    mi = rpmdbFreeIterator(mi);
+    return h;
+}
+
+rpmdbMatchIterator rpmtsPackagesIterator(rpmtsObject * s)
+{
+    rpmdbMatchIterator mi;
+
+    if (rpmtsOpenRdb(s))
+	return NULL;
+    if ((mi = rpmtsDbIterator(s, RPMDBI_PACKAGES, NULL, 0)) == NULL)
+	PyErr_SetString(pyrpmError, "rpmdb iterator failed");
+    return mi;
+}
+
+/** \ingroup py_c
+ * File path to look up, see rpmts_WhatOwns().
+ */
+struct ownerQuery_s {
+    char * path;
+    char * dn;			/*!< dirname, with trailing '/' */
+    const char * bn;		/*!< basename, points into path */
+    fingerPrint fp;
+    int nowners;
+    unsigned int * owners;	/*!< instances of owning packages */
+};
+
+/** \ingroup py_c
+ * Owning package NEVRA cache, sorted by instance.
+ */
+struct ownerCache_s {
+    int n;
+    int nalloced;
+    unsigned int * offsets;
+    char ** nevras;
+};
+
+static int ownerQueryCmp(const void * a, const void * b)
+{
+    const struct ownerQuery_s * qa = a;
+    const struct ownerQuery_s * qb = b;
+    int rc = strcmp(qa->bn, qb->bn);
+    return rc ? rc : strcmp(qa->path, qb->path);
+}
+
+/**
+ * Find the cache slot of a header instance.
+ * @retval *found	1 if the instance is cached
+ * @return		cache index (or insertion point)
+ */
+static int ownerCacheFind(struct ownerCache_s * oc, unsigned int offset,
+			  int * found)
+{
+    int lo = 0, hi = oc->n;
+
+    *found = 0;
+    while (lo < hi) {
+	int mid = (lo + hi) / 2;
+	if (oc->offsets[mid] == offset) {
+	    *found = 1;
+	    return mid;
+	}
+	if (oc->offsets[mid] < offset)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Add a header to the cache, formatting its NEVRA only once.
+ */
+static void ownerCacheAdd(struct ownerCache_s * oc, Header h, unsigned int offset)
+{
+    int found;
+    int ix = ownerCacheFind(oc, offset, &found);
+
+    if (found)
+	return;
+
+    if (oc->n == oc->nalloced) {
+	oc->nalloced = oc->nalloced ? 2 * oc->nalloced : 64;
+	oc->offsets = xrealloc(oc->offsets, oc->nalloced * sizeof(*oc->offsets));
+	oc->nevras = xrealloc(oc->nevras, oc->nalloced * sizeof(*oc->nevras));
+    }
+    memmove(oc->offsets + ix + 1, oc->offsets + ix,
+	    (oc->n - ix) * sizeof(*oc->offsets));
+    memmove(oc->nevras + ix + 1, oc->nevras + ix,
+	    (oc->n - ix) * sizeof(*oc->nevras));
+    oc->offsets[ix] = offset;
+    oc->nevras[ix] = headerFormat(h, HEADER_NEVRA_FMT, NULL);
+    oc->n++;
+}
+
+/**
+ * Look up the owners of a group of paths sharing a basename: one read of
+ * the basenames index, the hits are matched against the paths by
+ * fingerprint (so paths through symlinked directories match, as with
+ * ts.dbMatch('basenames', path)).
+ */
+static void ownerLookup(rpmtsObject * s, fingerPrintCache fpc,
+			struct ownerQuery_s * group, int ngroup,
+			struct ownerCache_s * oc)
+{
+    rpmdbMatchIterator mi;
+    rpmtd dirnames, dirindexes;
+    Header h;
+
+    mi = rpmtsDbIterator(s, RPMTAG_BASENAMES, NULL, 0);
+    /* without a key set, the iterator would walk the whole index */
+    if (mi == NULL || rpmdbExtendIterator(mi, group[0].bn, 0)) {
+	mi = rpmdbFreeIterator(mi);
+	return;
+    }
+
+    dirnames = rpmtdNew();
+    dirindexes = rpmtdNew();
+    while ((h = rpmdbNextIterator(mi)) != NULL) {
+	unsigned int offset = rpmdbGetIteratorOffset(mi);
+	const uint32_t * dix;
+	const char * dn;
+	fingerPrint fp;
+	int i;
+
+	headerGet(h, RPMTAG_DIRNAMES, dirnames, HEADERGET_MINMEM);
+	headerGet(h, RPMTAG_DIRINDEXES, dirindexes, HEADERGET_MINMEM);
+	dn = NULL;
+	if (rpmtdSetIndex(dirindexes, rpmdbGetIteratorFileNum(mi)) >= 0
+	 && (dix = rpmtdGetUint32(dirindexes)) != NULL
+	 && rpmtdSetIndex(dirnames, *dix) >= 0)
+	    dn = rpmtdGetString(dirnames);
+
+	if (dn != NULL) {
+	    fp = fpLookup(fpc, dn, group[0].bn, 1);
+	    for (i = 0; i < ngroup; i++) {
+		struct ownerQuery_s * q = &group[i];
+		if (!FP_EQUAL(fp, q->fp))
+		    continue;
+		ownerCacheAdd(oc, h, offset);
+		q->owners = xrealloc(q->owners,
+				     (q->nowners + 1) * sizeof(*q->owners));
+		q->owners[q->nowners++] = offset;
+	    }
+	}
+	rpmtdFreeData(dirnames);
+	rpmtdFreeData(dirindexes);
+    }
+    rpmtdFree(dirnames);
+    rpmtdFree(dirindexes);
+    mi = rpmdbFreeIterator(mi);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_WhatOwns(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    PyObject * paths, * seq, * result = NULL;
+    PyObject ** nevras = NULL;
+    struct ownerQuery_s * queries = NULL;
+    struct ownerCache_s oc;
+    fingerPrintCache fpc;
+    int i, j, n, nq = 0;
+    char * kwlist[] = {"paths", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:WhatOwns", kwlist, &paths))
+	return NULL;
+
+    if ((seq = PySequence_Fast(paths, "sequence of paths expected")) == NULL)
+	return NULL;
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    queries = xcalloc(n ? n : 1, sizeof(*queries));
+    for (i = 0; i < n; i++) {
+	PyObject * o = PySequence_Fast_GET_ITEM(seq, i);
+	struct ownerQuery_s * q = &queries[i];
+	char * bn;
+
+	if (!PyString_Check(o)) {
+	    PyErr_SetString(PyExc_TypeError, "sequence of paths expected");
+	    goto exit;
+	}
+	q->path = xstrdup(PyString_AsString(o));
+	bn = strrchr(q->path, '/');
+	q->bn = bn ? bn + 1 : q->path;
+	q->dn = xcalloc(q->bn - q->path + 1, sizeof(*q->dn));
+	memcpy(q->dn, q->path, q->bn - q->path);
+	nq = i + 1;
+    }
+
+    if (rpmtsOpenRdb(s))
+	goto exit;
+
+    memset(&oc, 0, sizeof(oc));
+
+    Py_BEGIN_ALLOW_THREADS
+    /* group lookups by basename, dropping duplicate paths */
+    qsort(queries, n, sizeof(*queries), ownerQueryCmp);
+    for (i = 0, j = 0; i < n; i++) {
+	if (j > 0 && !strcmp(queries[j-1].path, queries[i].path)) {
+	    free(queries[i].path);
+	    free(queries[i].dn);
+	    continue;
+	}
+	queries[j++] = queries[i];
+    }
+    nq = j;
+
+    fpc = fpCacheCreate(nq + 1);
+    for (i = 0; i < nq; i++)
+	queries[i].fp = fpLookup(fpc, queries[i].dn, queries[i].bn, 1);
+
+    for (i = 0; i < nq; i = j) {
+	j = i + 1;
+	while (j < nq && !strcmp(queries[j].bn, queries[i].bn))
+	    j++;
+	ownerLookup(s, fpc, queries + i, j - i, &oc);
+    }
+    fpc = fpCacheFree(fpc);
+    Py_END_ALLOW_THREADS
+
+    /* one string object per owning package */
+    nevras = xcalloc(oc.n ? oc.n : 1, sizeof(*nevras));
+    for (i = 0; i < oc.n; i++) {
+	nevras[i] = PyString_FromString(oc.nevras[i] ? oc.nevras[i] : "");
+	free(oc.nevras[i]);
+    }
+    free(oc.nevras);
+    for (i = 0; i < oc.n; i++) {
+	if (nevras[i] == NULL)
+	    goto cleanup;
+    }
+
+    if ((result = PyDict_New()) == NULL)
+	goto cleanup;
+    for (i = 0; i < nq; i++) {
+	struct ownerQuery_s * q = &queries[i];
+	PyObject * owners;
+	int rc;
+
+	if (q->nowners == 0)
+	    continue;
+	if ((owners = PyList_New(q->nowners)) == NULL)
+	    break;
+	for (j = 0; j < q->nowners; j++) {
+	    int found;
+	    int ix = ownerCacheFind(&oc, q->owners[j], &found);
+	    Py_INCREF(nevras[ix]);
+	    PyList_SET_ITEM(owners, j, nevras[ix]);
+	}
+	rc = PyDict_SetItemString(result, q->path, owners);
+	Py_DECREF(owners);
+	if (rc)
+	    break;
+    }
+    if (PyErr_Occurred())
+	Py_CLEAR(result);
+
+cleanup:
+    for (i = 0; i < oc.n; i++)
+	Py_XDECREF(nevras[i]);
+    free(nevras);
+    free(oc.offsets);
+
+exit:
+    for (i = 0; i < nq; i++) {
+	free(queries[i].path);
+	free(queries[i].dn);
+	free(queries[i].owners);
+    }
+    free(queries);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/**
+ * Run a batch of dependency queries against the rpmdb.
+ * @param s		transaction set object
+ * @param args		python arguments
+ * @param kwds		python keywords
+ * @param tagN		dependency tag of the queries
+ * @param lookup	per-query lookup function
+ * @return		list of instance lists, one per query
+ */
+static PyObject *
+rpmtsWhatDeps(rpmtsObject * s, PyObject * args, PyObject * kwds, rpmTag tagN,
+	      void (*lookup) (rpmtsObject *, rpmds, struct instances_s *))
+{
+    PyObject * deps, * seq, * result = NULL;
+    struct instances_s * results = NULL;
+    rpmds * queries = NULL;
+    int i, j, n, nq = 0;
+    char * kwlist[] = {"deps", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:WhatDeps", kwlist, &deps))
+	return NULL;
+
+    if ((seq = PySequence_Fast(deps, "sequence of dependencies expected")) == NULL)
+	return NULL;
+
+    n = PySequence_Fast_GET_SIZE(seq);
+    queries = xcalloc(n ? n : 1, sizeof(*queries));
+    results = xcalloc(n ? n : 1, sizeof(*results));
+    for (i = 0; i < n; i++) {
+	queries[i] = dsSingleFromPyObject(PySequence_Fast_GET_ITEM(seq, i), tagN);
+	if (queries[i] == NULL)
+	    goto exit;
+	nq = i + 1;
+    }
+
+    if (rpmtsOpenRdb(s))
+	goto exit;
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < nq; i++) {
+	rpmds dep = rpmdsInit(queries[i]);
+	if (rpmdsNext(dep) >= 0)
+	    lookup(s, dep, &results[i]);
+    }
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(nq);
+    for (i = 0; i < nq; i++) {
+	PyObject * insts = PyList_New(results[i].n);
+	for (j = 0; j < results[i].n; j++)
+	    PyList_SET_ITEM(insts, j, PyInt_FromLong(results[i].offsets[j]));
+	PyList_SET_ITEM(result, i, insts);
+    }
+
+exit:
+    for (i = 0; i < nq; i++) {
+	queries[i] = rpmdsFree(queries[i]);
+	free(results[i].offsets);
+    }
+    free(queries);
+    free(results);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_WhatProvides(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    return rpmtsWhatDeps(s, args, kwds, RPMTAG_REQUIRENAME, dbWhatProvides);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_WhatRequires(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    return rpmtsWhatDeps(s, args, kwds, RPMTAG_PROVIDENAME, dbWhatRequires);
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_DiskUsage(rpmtsObject * s, PyObject * args, PyObject * kwds)
+{
+    const char * rootDir = NULL;
+    PyObject * result;
+    rpmduPkg * pkgs;
+    rpmtsi pi;
+    rpmte te;
+    rpmdu du;
+    int i, npkgs = 0;
+    char * kwlist[] = {"rootDir", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z:DiskUsage", kwlist,
+	    &rootDir))
+	return NULL;
+
+    if (rootDir == NULL)
+	rootDir = rpmtsRootDir(s->ts);
+
+    /* The elements may change once the GIL is released: copy them. */
+    pkgs = xcalloc(rpmtsNElements(s->ts) + 1, sizeof(*pkgs));
+    pi = rpmtsiInit(s->ts);
+    while ((te = rpmtsiNext(pi, 0)) != NULL) {
+	rpmfi fi = rpmteFI(te);
+	if (fi != NULL)
+	    pkgs[npkgs++] = rpmduPkgNew(fi,
+				(rpmteType(te) == TR_REMOVED) ? -1 : 1);
+    }
+    pi = rpmtsiFree(pi);
+
+    du = rpmduNew(rootDir);
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < npkgs; i++)
+	rpmduAddPkg(du, pkgs[i]);
+    Py_END_ALLOW_THREADS
+
+    for (i = 0; i < npkgs; i++)
+	pkgs[i] = rpmduPkgFree(pkgs[i]);
+    free(pkgs);
+
+    result = rpmduDict(du);
+    du = rpmduFree(du);
+    return result;
+}
+
+/** \ingroup py_c
+ */
+static PyObject *
+rpmts_Snapshot(rpmtsObject * s)
+{
+    debug("(%p) ts %p\n", s, s->ts);
+
+    return rpmsnapshot_Create(s);
+}
+
 /**
  */
 static PyObject *
@@ -1028,16 +2770,11 @@ rpmts_Match(rpmtsObject * s, PyObject * args, PyObject * kwds)
     }
 
     /* XXX If not already opened, open the database O_RDONLY now. */
-    /* XXX FIXME: lazy default rdonly open also done by rpmtsInitIterator(). */
-    if (rpmtsGetRdb(s->ts) == NULL) {
-	int rc = rpmtsOpenDB(s->ts, O_RDONLY);
-	if (rc || rpmtsGetRdb(s->ts) == NULL) {
-	    PyErr_SetString(pyrpmError, "rpmdb open failed");
-	    return NULL;
-	}
-    }
+    if (rpmtsOpenRdb(s))
+	return NULL;
 
-    return rpmmi_Wrap( rpmtsInitIterator(s->ts, tag, key, len), (PyObject*)s);
+    return rpmmi_Wrap( rpmtsDbIterator(s, tag, key, len), (PyObject*)s,
+			tag, key, len);
 }
 
 /** \ingroup py_c
@@ -1047,8 +2784,23 @@ static struct PyMethodDef rpmts_methods[] = {
 	NULL },
  {"addErase",	(PyCFunction) rpmts_AddErase,	METH_VARARGS|METH_KEYWORDS,
 	NULL },
+ {"addInstallMany",	(PyCFunction) rpmts_AddInstallMany,	METH_VARARGS|METH_KEYWORDS,
+"ts.addInstallMany(headers[, keys][, how]) -> None\n\
+- Add install (how=\"i\") or upgrade (how=\"u\") elements for headers.\n\
+  If adding one fails, the elements added before it stay in the\n\
+  transaction set; the error names the index of the failing header.\n" },
+ {"addEraseMany",	(PyCFunction) rpmts_AddEraseMany,	METH_VARARGS|METH_KEYWORDS,
+"ts.addEraseMany(items) -> None\n\
+- Add erase elements for installed headers, instance numbers or names.\n" },
  {"check",	(PyCFunction) rpmts_Check,	METH_VARARGS|METH_KEYWORDS,
-	NULL },
+"ts.check([callback[, batch][, incremental]]) -> [prob, ...] or None\n\
+- Check dependencies of the transaction set, returning rpm.prob objects.\n\
+  With batch=True, callback(ts, [ds, ...]) is called once per pass with all\n\
+  unresolved dependencies; a true return after adding elements re-runs it.\n\
+  With incremental=True, the binding's own checker only evaluates elements\n\
+  added since the previous incremental check and re-evaluates the problems\n\
+  found then. Its unresolved dependencies are handed to the callback once\n\
+  the pass is done, it is re-run if the callback added elements.\n" },
  {"order",	(PyCFunction) rpmts_Order,	METH_NOARGS,
 	NULL },
  {"setFlags",	(PyCFunction) rpmts_SetFlags,	METH_VARARGS|METH_KEYWORDS,
@@ -1063,11 +2815,31 @@ static struct PyMethodDef rpmts_methods[] = {
 "ts.problems() -> ps\n\
 - Return current problem set.\n" },
  {"run",	(PyCFunction) rpmts_Run,	METH_VARARGS|METH_KEYWORDS,
-"ts.run(callback, data) -> (problems)\n\
+"ts.run(callback, data[, progressInterval][, progressBytes][, openKeys][, readahead])\n\
+    -> (problems)\n\
 - Run a transaction set, returning list of problems found.\n\
-  Note: The callback may not be None.\n" },
+  Progress events closer than progressInterval msecs or progressBytes\n\
+  apart are coalesced before reaching the callback.\n\
+  With openKeys=True, element keys are package paths opened natively,\n\
+  a background thread prefetches the next readahead packages.\n\
+  The callback may be None, e.g. to only collect ts.runStats().\n" },
+ {"runStats",	(PyCFunction) rpmts_RunStats,	METH_NOARGS,
+"ts.runStats() -> [{'nevra', 'type', 'key', 'usecs', 'bytes',\n\
+    'uncompressUsecs', 'scriptletUsecs', 'digestUsecs'}, ...]\n\
+- Return per element metrics of the last ts.run(): wall time from open\n\
+  to close (install) or start to stop (erase), payload bytes written and\n\
+  time spent uncompressing, in scriptlets and computing digests.\n" },
  {"clean",	(PyCFunction) rpmts_Clean,	METH_NOARGS,
 	NULL },
+ {"stats",	(PyCFunction) rpmts_Stats,	METH_NOARGS,
+"ts.stats() -> {phase: {'count', 'usecs', 'bytes'}, ...}\n\
+- Return accumulated operation statistics of the transaction set. Phases\n\
+  are total, check, order, fingerprint, repackage, install, erase,\n\
+  scriptlets, compress, uncompress, digest, signature, dbadd, dbremove,\n\
+  dbget, dbput and dbdel.\n" },
+ {"resetStats",	(PyCFunction) rpmts_ResetStats,	METH_NOARGS,
+"ts.resetStats() -> None\n\
+- Zero the operation statistics of the transaction set.\n" },
  {"openDB",	(PyCFunction) rpmts_OpenDB,	METH_NOARGS,
 "ts.openDB() -> None\n\
 - Open the default transaction rpmdb.\n\
@@ -1086,8 +2858,27 @@ static struct PyMethodDef rpmts_methods[] = {
 "ts.verifyDB() -> None\n\
 - Verify the default transaction rpmdb.\n" },
  {"hdrFromFdno",(PyCFunction) rpmts_HdrFromFdno,METH_VARARGS|METH_KEYWORDS,
-"ts.hdrFromFdno(fdno) -> hdr\n\
-- Read a package header from a file descriptor.\n" },
+"ts.hdrFromFdno(fdno[, useCache]) -> hdr\n\
+- Read a package header from a file descriptor.\n\
+  With a verify cache set, unchanged files verified before skip\n\
+  signature and digest checks unless useCache is False.\n" },
+ {"verifyPackages",(PyCFunction) rpmts_VerifyPackages,METH_VARARGS|METH_KEYWORDS,
+"ts.verifyPackages(paths[, workers][, vsflags][, headers][, callback])\n\
+    -> [{'path', 'rc', 'error'[, 'header']}, ...]\n\
+- Read and verify package files on a pool of native threads. The\n\
+  results (rc is one of rpm.RPMRC_*) are returned in input order, or\n\
+  passed to callback(result) one by one as they become available.\n\
+  Each worker loads the keys of the ts keyring for itself. The workers\n\
+  open files and read ahead concurrently, but rpm reads and checks one\n\
+  package at a time. Failures are not logged, the results report them;\n\
+  while a package is being read, rpm logs nothing below RPMLOG_EMERG.\n" },
+ {"setVerifyCache",(PyCFunction) rpmts_SetVerifyCache,METH_VARARGS|METH_KEYWORDS,
+"ts.setVerifyCache(path[, keyringId]) -> None\n\
+- Use (or with None, stop using) a persistent cache of verified package\n\
+  files, keyed by device, inode, size, mtime, ctime, vsflags and keyring.\n\
+  The keyring is identified by keyringId, or else by the keys of the\n\
+  keyring set with ts.setKeyring() or the installed gpg-pubkeys.\n\
+  Existing files other than verification caches are refused.\n" },
  {"hdrCheck",	(PyCFunction) rpmts_HdrCheck,	METH_VARARGS|METH_KEYWORDS,
 	NULL },
  {"setVSFlags",(PyCFunction) rpmts_SetVSFlags,	METH_VARARGS|METH_KEYWORDS,
@@ -1116,6 +2907,29 @@ static struct PyMethodDef rpmts_methods[] = {
  {"dbMatch",	(PyCFunction) rpmts_Match,	METH_VARARGS|METH_KEYWORDS,
 "ts.dbMatch([TagN, [key, [len]]]) -> mi\n\
 - Create a match iterator for the default transaction rpmdb.\n" },
+ {"whatOwns",	(PyCFunction) rpmts_WhatOwns,	METH_VARARGS|METH_KEYWORDS,
+"ts.whatOwns(paths) -> {path: [nevra, ...]}\n\
+- Look up the packages owning each of the file paths in one batch, with\n\
+  one basenames index read per basename. Directories are compared by\n\
+  fingerprint, as ts.dbMatch('basenames', path) does. Paths not owned\n\
+  by any package are left out of the result.\n" },
+ {"whatProvides",	(PyCFunction) rpmts_WhatProvides,	METH_VARARGS|METH_KEYWORDS,
+"ts.whatProvides(deps) -> [[instance, ...], ...]\n\
+- Return instances of installed packages satisfying each dependency.\n\
+  Dependencies are rpm.ds objects (current entry), (N, Flags, EVR)\n\
+  tuples or plain names. EVR ranges are checked natively.\n" },
+ {"whatRequires",	(PyCFunction) rpmts_WhatRequires,	METH_VARARGS|METH_KEYWORDS,
+"ts.whatRequires(deps) -> [[instance, ...], ...]\n\
+- Return instances of installed packages with a requirement matched by\n\
+  each provided dependency, given as for ts.whatProvides().\n" },
+ {"diskUsage",	(PyCFunction) rpmts_DiskUsage,	METH_VARARGS|METH_KEYWORDS,
+"ts.diskUsage([rootDir]) -> {mountpoint: {...}, ...}\n\
+- Return the disk space and inodes the transaction needs per filesystem,\n\
+  files of erase elements counting as freed. Each entry holds bytes,\n\
+  inodes (needed, negative when freed), bavail, iavail and bsize.\n" },
+ {"snapshot",	(PyCFunction) rpmts_Snapshot,	METH_NOARGS,
+"ts.snapshot() -> snap\n\
+- Index the installed packages in memory for fast repeated queries.\n" },
  {"setKeyring",(PyCFunction) rpmts_setKeyring,	METH_VARARGS|METH_KEYWORDS,
 	NULL },
  {"getKeyring",(PyCFunction) rpmts_getKeyring,	METH_VARARGS|METH_KEYWORDS,
@@ -1129,6 +2943,11 @@ static void rpmts_dealloc(rpmtsObject * s)
 {
     debug("%p -- ts %p db %p\n", s, s->ts, rpmtsGetRdb(s->ts));
     s->ts = rpmtsFree(s->ts);
+    s->vcache = rpmvcacheFree(s->vcache);
+    Py_XDECREF(s->keyring);
+    rpmtsMetricsFree(s);
+    s->check = rpmcheckFree(s->check);
+    s->checkProbs = rpmpsFree(s->checkProbs);
 
     if (s->scriptFd) Fclose(s->scriptFd);
     /* this will free the keyList, and decrement the ref count of all
@@ -1176,6 +2995,11 @@ static void rpmts_free(rpmtsObject * s)
 {
     debug("%p -- ts %p db %p\n", s, s->ts, rpmtsGetRdb(s->ts));
     s->ts = rpmtsFree(s->ts);
+    s->vcache = rpmvcacheFree(s->vcache);
+    Py_XDECREF(s->keyring);
+    rpmtsMetricsFree(s);
+    s->check = rpmcheckFree(s->check);
+    s->checkProbs = rpmpsFree(s->checkProbs);
 
     if (s->scriptFd)
 	Fclose(s->scriptFd);
@@ -1195,12 +3019,13 @@ static PyObject * rpmts_new(PyTypeObject * subtype, PyObject *args, PyObject *kw
 
     char * rootDir = "/";
     rpmVSFlags vsflags = rpmExpandNumeric("%{?__vsflags}");
-    char * kwlist[] = {"rootdir", "vsflags", 0};
+    int sharedDB = 0;
+    char * kwlist[] = {"rootdir", "vsflags", "sharedDB", 0};
 
     debug("(%p,%p,%p)\n", s, args, kwds);
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|si:rpmts_init", kwlist,
-	    &rootDir, &vsflags))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sii:rpmts_init", kwlist,
+	    &rootDir, &vsflags, &sharedDB))
 	return NULL;
 
     s = PyObject_New(rpmtsObject, subtype);
@@ -1215,6 +3040,16 @@ static PyObject * rpmts_new(PyTypeObject * subtype, PyObject *args, PyObject *kw
     (void) rpmtsSetVSFlags(s->ts, vsflags);
     s->keyList = PyList_New(0);
     s->scriptFd = NULL;
+    s->vcache = NULL;
+    s->vcacheKeyring = 0;
+    s->keyring = NULL;
+    s->dbKeyring = 0;
+    memset(&s->dbKeyringStamp, 0, sizeof(s->dbKeyringStamp));
+    s->metrics = NULL;
+    s->nmetrics = 0;
+    s->check = NULL;
+    s->checkProbs = NULL;
+    s->sharedDB = sharedDB;
     s->tsi = NULL;
     s->tsiFilter = 0;
 
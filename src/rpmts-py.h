@@ -5,6 +5,8 @@
 
 #include <rpm/rpmts.h>
 
+#include "rpmdbpool-py.h"
+
 /** \ingroup py_c
  * \file python/rpmts-py.h
  */
@@ -18,6 +20,16 @@ typedef struct rpmtsObject_s {
     rpmtsi tsi;
     rpmElementType tsiFilter;
     rpmprobFilterFlags ignoreSet;
+    struct rpmvcache_s * vcache;	/*!< package verification cache */
+    uint64_t vcacheKeyring;		/*!< fixed keyring fingerprint (or 0) */
+    PyObject * keyring;			/*!< keyring set with ts.setKeyring() */
+    uint64_t dbKeyring;			/*!< fingerprint of rpmdb gpg-pubkeys */
+    struct rpmdbStamp_s dbKeyringStamp;
+    struct teMetrics_s * metrics;	/*!< per element metrics of last run */
+    int nmetrics;
+    struct rpmcheck_s * check;		/*!< incremental dependency checker */
+    rpmps checkProbs;			/*!< problems of last incremental check */
+    int sharedDB;			/*!< query the pooled read-only rpmdb? */
 } rpmtsObject;
 
 extern PyTypeObject rpmts_Type;
@@ -30,4 +42,41 @@ enum {
 
 PyObject * rpmts_Create(PyObject * s, PyObject * args, PyObject * kwds);
 
+/**
+ * Initialize an rpmdb iterator on the shared read-only handle if the
+ * transaction set borrows from the pool, on its own rpmdb otherwise.
+ * Needs no GIL.
+ * @param s		transaction set
+ * @param tag		rpmdb index (or RPMDBI_PACKAGES)
+ * @param key		key value (or NULL)
+ * @param keylen	key length (0 for strings)
+ * @return		iterator (or NULL)
+ */
+rpmdbMatchIterator rpmtsDbIterator(rpmtsObject * s, rpmTag tag,
+		const void * key, size_t keylen);
+
+/**
+ * Return an iterator over all installed packages, opening the rpmdb
+ * (or borrowing the shared one) as needed.
+ * @param s		transaction set
+ * @return		iterator, NULL with python error set on failure
+ */
+rpmdbMatchIterator rpmtsPackagesIterator(rpmtsObject * s);
+
+/**
+ * Return the header of an installed package.
+ * @param s		transaction set
+ * @param instance	rpmdb instance
+ * @return		header (linked), NULL if not found
+ */
+Header rpmtsInstanceHeader(rpmtsObject * s, unsigned int instance);
+
+/**
+ * Give a ts used by another thread a keyring of its own, with the keys
+ * of the ts: the reference counts of keyrings aren't thread safe.
+ * @param s		transaction set
+ * @param wts		the other thread's transaction set
+ */
+void rpmtsCopyKeyring(rpmtsObject * s, rpmts wts);
+
 #endif
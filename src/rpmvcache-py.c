@@ -0,0 +1,244 @@
+/** \ingroup py_c
+ * \file python/rpmvcache-py.c
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rpm/rpmdb.h>
+#include <rpm/rpmstring.h>
+
+#include "rpmvcache-py.h"
+
+#define VCACHE_MAGIC	"RPMVC002"
+#define VCACHE_MAGICLEN	5	/* "RPMVC", common to all versions */
+#define VCACHE_SLOTS	65536	/* power of 2 */
+#define VCACHE_PROBES	8
+
+/* Nanoseconds of the inode change time, where struct stat has them. */
+#if defined(__GLIBC__) && defined(st_ctime)
+#define	STAT_CTIME_NSEC(sb)	((sb)->st_ctim.tv_nsec)
+#else
+#define	STAT_CTIME_NSEC(sb)	0
+#endif
+
+/**
+ * Cache file layout: a header followed by an open addressing table.
+ */
+struct vcacheHeader_s {
+    char magic[8];
+    uint32_t nslots;
+    uint32_t pad;
+};
+
+struct vcacheEntry_s {
+    struct rpmvcacheKey_s key;
+    uint64_t check;		/*!< hash of key, detects torn/empty entries */
+};
+
+struct rpmvcache_s {
+    struct vcacheHeader_s * hdr;
+    struct vcacheEntry_s * slots;
+    size_t maplen;
+    pthread_mutex_t lock;	/*!< workers may add concurrently */
+};
+
+uint64_t rpmvcacheHash(uint64_t h, const void * data, size_t len)
+{
+    const unsigned char * p = data;
+
+    /* FNV-1a */
+    if (h == 0)
+	h = 14695981039346656037ULL;
+    while (len--) {
+	h ^= *p++;
+	h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t keyHash(const struct rpmvcacheKey_s * key)
+{
+    uint64_t h = rpmvcacheHash(0, key, sizeof(*key));
+    return h ? h : 1;
+}
+
+rpmvcache rpmvcacheNew(const char * path)
+{
+    struct vcacheHeader_s * hdr, ohdr;
+    size_t maplen = sizeof(*hdr) + VCACHE_SLOTS * sizeof(struct vcacheEntry_s);
+    struct stat sb;
+    rpmvcache vc;
+    void * map = MAP_FAILED;
+    int init = 0;
+    int fdno;
+
+    if ((fdno = open(path, O_RDWR|O_CREAT, 0644)) < 0)
+	return NULL;
+    /* Serialize with other processes creating the same cache. */
+    if (flock(fdno, LOCK_EX) || fstat(fdno, &sb))
+	goto exit;
+
+    /*
+     * Only ever (re)initialize a file that is empty or an older version
+     * of the cache, anything else is most likely a wrong path.
+     */
+    memset(&ohdr, 0, sizeof(ohdr));
+    if (!S_ISREG(sb.st_mode)) {
+	errno = EINVAL;
+	goto exit;
+    } else if (sb.st_size == 0) {
+	init = 1;
+    } else if (pread(fdno, &ohdr, sizeof(ohdr), 0) != sizeof(ohdr)
+	    || memcmp(ohdr.magic, VCACHE_MAGIC, VCACHE_MAGICLEN)) {
+	errno = EINVAL;
+	goto exit;
+    } else if (memcmp(ohdr.magic, VCACHE_MAGIC, sizeof(ohdr.magic))
+	    || ohdr.nslots != VCACHE_SLOTS || (size_t) sb.st_size != maplen) {
+	init = 1;
+    }
+
+    if (init && (ftruncate(fdno, 0) || ftruncate(fdno, maplen)))
+	goto exit;
+    map = mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_SHARED, fdno, 0);
+    if (map == MAP_FAILED)
+	goto exit;
+
+    hdr = map;
+    if (init) {
+	memcpy(hdr->magic, VCACHE_MAGIC, sizeof(hdr->magic));
+	hdr->nslots = VCACHE_SLOTS;
+    }
+
+exit:
+    if (map == MAP_FAILED) {
+	int err = errno;
+	close(fdno);		/* also releases the lock */
+	errno = err;
+	return NULL;
+    }
+    close(fdno);
+
+    vc = xcalloc(1, sizeof(*vc));
+    vc->hdr = hdr;
+    vc->slots = (struct vcacheEntry_s *) (hdr + 1);
+    vc->maplen = maplen;
+    pthread_mutex_init(&vc->lock, NULL);
+    return vc;
+}
+
+rpmvcache rpmvcacheFree(rpmvcache vc)
+{
+    if (vc == NULL)
+	return NULL;
+    munmap(vc->hdr, vc->maplen);
+    pthread_mutex_destroy(&vc->lock);
+    free(vc);
+    return NULL;
+}
+
+int rpmvcacheKey(int fdno, rpmVSFlags vsflags, uint64_t keyring,
+		struct rpmvcacheKey_s * key)
+{
+    struct stat sb;
+
+    if (fdno < 0 || fstat(fdno, &sb) || !S_ISREG(sb.st_mode))
+	return -1;
+    memset(key, 0, sizeof(*key));
+    key->dev = sb.st_dev;
+    key->ino = sb.st_ino;
+    key->size = sb.st_size;
+    key->mtime = sb.st_mtime;
+    /* mtime can be put back after rewriting a file, ctime can't */
+    key->ctime = sb.st_ctime;
+    key->ctimensec = STAT_CTIME_NSEC(&sb);
+    key->keyring = keyring;
+    key->vsflags = vsflags;
+    return 0;
+}
+
+int rpmvcacheLookup(rpmvcache vc, const struct rpmvcacheKey_s * key)
+{
+    uint64_t h = keyHash(key);
+    unsigned int mask = vc->hdr->nslots - 1;
+    int found = 0;
+    int i;
+
+    pthread_mutex_lock(&vc->lock);
+    for (i = 0; i < VCACHE_PROBES; i++) {
+	struct vcacheEntry_s * e = &vc->slots[(h + i) & mask];
+	if (e->check == h && !memcmp(&e->key, key, sizeof(*key))) {
+	    found = 1;
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&vc->lock);
+    return found;
+}
+
+void rpmvcacheAdd(rpmvcache vc, const struct rpmvcacheKey_s * key)
+{
+    uint64_t h = keyHash(key);
+    unsigned int mask = vc->hdr->nslots - 1;
+    struct vcacheEntry_s * e = NULL;
+    int i;
+
+    pthread_mutex_lock(&vc->lock);
+    /* Reuse a free or stale (same file, changed since) slot ... */
+    for (i = 0; i < VCACHE_PROBES; i++) {
+	struct vcacheEntry_s * s = &vc->slots[(h + i) & mask];
+	if (s->check == 0 || s->check != keyHash(&s->key)
+	 || (s->key.dev == key->dev && s->key.ino == key->ino)) {
+	    e = s;
+	    break;
+	}
+    }
+    /* ... otherwise evict the home slot. */
+    if (e == NULL)
+	e = &vc->slots[h & mask];
+    e->check = 0;
+    e->key = *key;
+    e->check = h;
+    pthread_mutex_unlock(&vc->lock);
+}
+
+static int strCmp(const void * a, const void * b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+uint64_t rpmvcacheKeyringId(rpmdbMatchIterator mi)
+{
+    char ** keys = NULL;
+    int nkeys = 0;
+    uint64_t h = 0;
+    Header hdr;
+    int i;
+
+    while ((hdr = rpmdbNextIterator(mi)) != NULL) {
+	char * vr = headerFormat(hdr, "%{version}-%{release}", NULL);
+	if (vr == NULL)
+	    continue;
+	keys = xrealloc(keys, (nkeys + 1) * sizeof(*keys));
+	keys[nkeys++] = vr;
+    }
+    mi = rpmdbFreeIterator(mi);
+
+    /* Order of installation does not matter. */
+    if (nkeys > 1)
+	qsort(keys, nkeys, sizeof(*keys), strCmp);
+    for (i = 0; i < nkeys; i++) {
+	h = rpmvcacheHash(h, keys[i], strlen(keys[i]) + 1);
+	free(keys[i]);
+    }
+    free(keys);
+    return h;
+}
@@ -0,0 +1,81 @@
+#ifndef H_RPMVCACHE_PY
+#define H_RPMVCACHE_PY
+
+#include <stdint.h>
+#include <rpm/rpmts.h>
+#include <rpm/rpmdb.h>
+
+/** \ingroup py_c
+ * \file python/rpmvcache-py.h
+ */
+
+/**
+ * A persistent cache of successful package verifications, stored in a
+ * small fixed size mmap'd file shared by all users of the same path.
+ */
+typedef struct rpmvcache_s * rpmvcache;
+
+/**
+ * Identity of a package file as last verified.
+ */
+struct rpmvcacheKey_s {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t ctime;		/*!< can't be reset from userspace */
+    uint64_t ctimensec;
+    uint64_t keyring;		/*!< keyring fingerprint */
+    uint64_t vsflags;
+};
+
+/**
+ * Open (creating if necessary) a verification cache. Existing files
+ * are only used if they are verification caches (or empty).
+ * @param path		cache file path
+ * @return		cache, NULL on error (errno set, EINVAL if the
+ *			file is not a verification cache)
+ */
+rpmvcache rpmvcacheNew(const char * path);
+
+/**
+ * Unmap and free a verification cache.
+ * @return		NULL always
+ */
+rpmvcache rpmvcacheFree(rpmvcache vc);
+
+/**
+ * Fill in the key of an open package file.
+ * @param fdno		file descriptor of the package
+ * @param vsflags	verify flags the package is to be checked with
+ * @param keyring	fingerprint of the keyring it is checked against
+ * @retval key		package file key
+ * @return		0 on success, -1 if fdno is not a regular file
+ */
+int rpmvcacheKey(int fdno, rpmVSFlags vsflags, uint64_t keyring,
+		struct rpmvcacheKey_s * key);
+
+/**
+ * Look up a package file.
+ * @return		1 if the file has been verified before, 0 otherwise
+ */
+int rpmvcacheLookup(rpmvcache vc, const struct rpmvcacheKey_s * key);
+
+/**
+ * Remember a successfully verified package file.
+ */
+void rpmvcacheAdd(rpmvcache vc, const struct rpmvcacheKey_s * key);
+
+/**
+ * Compute a keyring fingerprint from the gpg-pubkey headers of the rpmdb.
+ * @param mi		iterator over the gpg-pubkey headers (freed)
+ * @return		fingerprint
+ */
+uint64_t rpmvcacheKeyringId(rpmdbMatchIterator mi);
+
+/**
+ * Hash a string into a fingerprint.
+ */
+uint64_t rpmvcacheHash(uint64_t h, const void * data, size_t len);
+
+#endif
@@ -0,0 +1,230 @@
+/** \ingroup py_c
+ * \file python/rpmverify-py.c
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rpm/rpmpgp.h>
+#include <rpm/rpmstring.h>
+
+#include "rpmverify-py.h"
+
+void fileVerifyInit(struct fileVerify_s * fv, rpmfi fi, const char * rootDir,
+		rpmVerifyAttrs flags)
+{
+    const char * fn = rpmfiFN(fi);
+    const unsigned char * digest;
+
+    memset(fv, 0, sizeof(*fv));
+    if (rootDir == NULL || !strcmp(rootDir, "/"))
+	fv->path = xstrdup(fn);
+    else
+	fv->path = rstrscat(NULL, rootDir, fn, NULL);
+    fv->fx = rpmfiFX(fi);
+    fv->fflags = rpmfiFFlags(fi);
+    fv->flags = flags & rpmfiVFlags(fi);
+    fv->mode = rpmfiFMode(fi);
+    fv->size = rpmfiFSize(fi);
+    fv->mtime = rpmfiFMtime(fi);
+    fv->rdev = rpmfiFRdev(fi);
+    fv->link = rpmfiFLink(fi);
+    fv->user = rpmfiFUser(fi);
+    fv->group = rpmfiFGroup(fi);
+    if ((digest = rpmfiFDigest(fi, &fv->algo, &fv->diglen)) != NULL) {
+	fv->digest = xmalloc(fv->diglen);
+	memcpy(fv->digest, digest, fv->diglen);
+    }
+
+    /* Contents of %ghost files are not known, as rpm -V does. */
+    if (fv->fflags & RPMFILE_GHOST)
+	fv->flags &= ~(RPMVERIFY_FILEDIGEST | RPMVERIFY_FILESIZE |
+		       RPMVERIFY_MTIME | RPMVERIFY_LINKTO);
+}
+
+void fileVerifyFree(struct fileVerify_s * fv)
+{
+    free(fv->path);
+    free(fv->digest);
+    fv->path = NULL;
+    fv->digest = NULL;
+}
+
+/** Size of the per worker read buffer. */
+#define	DIGEST_BUFSIZE		(256 * 1024)
+
+/**
+ * Digest a file, comparing against the expected raw digest.
+ * The file is read through the per worker buffer with sequential
+ * read-ahead. It is not mapped: installed files can be truncated while
+ * they are verified, which would raise SIGBUS on a mapping.
+ * @param fv		file (digest, algo and diglen are used)
+ * @param cache		per worker state (read buffer)
+ * @return		0 on match, 1 on mismatch, -1 on read failure
+ */
+static int fileDigest(struct fileVerify_s * fv,
+		struct fileVerifyCache_s * cache)
+{
+    DIGEST_CTX ctx;
+    void * digest = NULL;
+    size_t diglen = 0;
+    int rc = 0;
+    int fd;
+
+    if ((fd = open(fv->path, O_RDONLY)) < 0)
+	return -1;
+
+    ctx = rpmDigestInit(fv->algo, RPMDIGEST_NONE);
+#if defined(POSIX_FADV_SEQUENTIAL)
+    (void) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    if (cache->buf == NULL)
+	cache->buf = xmalloc(DIGEST_BUFSIZE);
+    while (1) {
+	ssize_t nb = read(fd, cache->buf, DIGEST_BUFSIZE);
+	if (nb == 0)
+	    break;
+	if (nb < 0) {
+	    if (errno == EINTR)
+		continue;
+	    rc = -1;
+	    break;
+	}
+	(void) rpmDigestUpdate(ctx, cache->buf, nb);
+    }
+
+    (void) close(fd);
+    (void) rpmDigestFinal(ctx, &digest, &diglen, 0);
+    if (rc == 0 && (diglen != fv->diglen || memcmp(digest, fv->digest, diglen)))
+	rc = 1;
+    free(digest);
+    return rc;
+}
+
+void fileVerifyCacheFree(struct fileVerifyCache_s * cache)
+{
+    free(cache->buf);
+    cache->buf = NULL;
+}
+
+static const char * uidName(struct fileVerifyCache_s * cache, uid_t uid)
+{
+    if (cache->user[0] == '\0' || cache->uid != uid) {
+	struct passwd pw, * pwp = NULL;
+	char buf[1024];
+
+	if (getpwuid_r(uid, &pw, buf, sizeof(buf), &pwp) || pwp == NULL)
+	    return NULL;
+	cache->uid = uid;
+	strncpy(cache->user, pw.pw_name, sizeof(cache->user) - 1);
+	cache->user[sizeof(cache->user) - 1] = '\0';
+    }
+    return cache->user;
+}
+
+static const char * gidName(struct fileVerifyCache_s * cache, gid_t gid)
+{
+    if (cache->group[0] == '\0' || cache->gid != gid) {
+	struct group gr, * grp = NULL;
+	char buf[4096];
+
+	if (getgrgid_r(gid, &gr, buf, sizeof(buf), &grp) || grp == NULL)
+	    return NULL;
+	cache->gid = gid;
+	strncpy(cache->group, gr.gr_name, sizeof(cache->group) - 1);
+	cache->group[sizeof(cache->group) - 1] = '\0';
+    }
+    return cache->group;
+}
+
+void fileVerify(struct fileVerify_s * fv, struct fileVerifyCache_s * cache)
+{
+    rpmVerifyAttrs flags = fv->flags;
+    struct stat sb;
+
+    fv->res = RPMVERIFY_NONE;
+
+    if (lstat(fv->path, &sb) < 0) {
+	if (!(fv->fflags & (RPMFILE_MISSINGOK | RPMFILE_GHOST)))
+	    fv->res |= RPMVERIFY_LSTATFAIL;
+	return;
+    }
+
+    /* Not everything applies to every file type, same rules as rpm. */
+    if (S_ISDIR(sb.st_mode) || S_ISFIFO(sb.st_mode))
+	flags &= ~(RPMVERIFY_FILEDIGEST | RPMVERIFY_FILESIZE |
+		   RPMVERIFY_MTIME | RPMVERIFY_LINKTO | RPMVERIFY_CAPS);
+    else if (S_ISLNK(sb.st_mode))
+	flags &= ~(RPMVERIFY_FILEDIGEST | RPMVERIFY_FILESIZE |
+		   RPMVERIFY_MTIME | RPMVERIFY_MODE | RPMVERIFY_CAPS);
+    else if (S_ISCHR(sb.st_mode) || S_ISBLK(sb.st_mode))
+	flags &= ~(RPMVERIFY_FILEDIGEST | RPMVERIFY_FILESIZE |
+		   RPMVERIFY_MTIME | RPMVERIFY_LINKTO | RPMVERIFY_CAPS);
+    else
+	flags &= ~RPMVERIFY_LINKTO;
+
+    if ((flags & RPMVERIFY_FILEDIGEST) && fv->digest != NULL) {
+	/* A file of the wrong size can't have the right contents. */
+	if (sb.st_size != fv->size) {
+	    fv->res |= RPMVERIFY_FILEDIGEST;
+	} else {
+	    switch (fileDigest(fv, cache)) {
+	    case -1:	fv->res |= RPMVERIFY_READFAIL;		break;
+	    case 1:	fv->res |= RPMVERIFY_FILEDIGEST;	break;
+	    default:	break;
+	    }
+	}
+    }
+
+    if (flags & RPMVERIFY_LINKTO) {
+	char linkto[PATH_MAX + 1];
+	ssize_t size = readlink(fv->path, linkto, sizeof(linkto) - 1);
+	if (size < 0) {
+	    fv->res |= RPMVERIFY_READLINKFAIL;
+	} else {
+	    linkto[size] = '\0';
+	    if (fv->link == NULL || strcmp(linkto, fv->link))
+		fv->res |= RPMVERIFY_LINKTO;
+	}
+    }
+
+    if ((flags & RPMVERIFY_FILESIZE) && sb.st_size != fv->size)
+	fv->res |= RPMVERIFY_FILESIZE;
+
+    if ((flags & RPMVERIFY_MTIME) && sb.st_mtime != fv->mtime)
+	fv->res |= RPMVERIFY_MTIME;
+
+    if ((flags & RPMVERIFY_MODE) && sb.st_mode != fv->mode)
+	fv->res |= RPMVERIFY_MODE;
+
+    if (flags & RPMVERIFY_RDEV) {
+	if (S_ISCHR(fv->mode) != S_ISCHR(sb.st_mode)
+	 || S_ISBLK(fv->mode) != S_ISBLK(sb.st_mode)) {
+	    fv->res |= RPMVERIFY_RDEV;
+	} else if (S_ISCHR(fv->mode) || S_ISBLK(fv->mode)) {
+	    /* rpm stores 16 bit device numbers */
+	    if ((rpm_rdev_t) (sb.st_rdev & 0xffff) != fv->rdev)
+		fv->res |= RPMVERIFY_RDEV;
+	}
+    }
+
+    if (flags & RPMVERIFY_USER) {
+	const char * name = uidName(cache, sb.st_uid);
+	if (name == NULL || fv->user == NULL || strcmp(name, fv->user))
+	    fv->res |= RPMVERIFY_USER;
+    }
+
+    if (flags & RPMVERIFY_GROUP) {
+	const char * name = gidName(cache, sb.st_gid);
+	if (name == NULL || fv->group == NULL || strcmp(name, fv->group))
+	    fv->res |= RPMVERIFY_GROUP;
+    }
+}
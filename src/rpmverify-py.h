@@ -0,0 +1,72 @@
+#ifndef H_RPMVERIFY_PY
+#define H_RPMVERIFY_PY
+
+#include <rpm/rpmfi.h>
+#include <rpm/rpmvf.h>
+
+/** \ingroup py_c
+ * \file python/rpmverify-py.h
+ */
+
+/**
+ * Expected state of a file, copied out of an rpmfi so that files can be
+ * verified from worker threads.
+ */
+struct fileVerify_s {
+    char * path;		/*!< on-disk path (root included) */
+    int fx;			/*!< file index */
+    rpmfileAttrs fflags;
+    rpmVerifyAttrs flags;	/*!< attributes to verify */
+    rpm_mode_t mode;
+    rpm_loff_t size;
+    rpm_time_t mtime;
+    rpm_rdev_t rdev;
+    const char * link;		/*!< borrowed from the rpmfi */
+    const char * user;		/*!< borrowed from the rpmfi */
+    const char * group;		/*!< borrowed from the rpmfi */
+    unsigned char * digest;	/*!< raw digest (or NULL) */
+    size_t diglen;
+    pgpHashAlgo algo;
+    rpmVerifyAttrs res;		/*!< mismatches found */
+};
+
+/**
+ * Per worker state: lookup cache of user and group names, read buffer.
+ */
+struct fileVerifyCache_s {
+    uid_t uid;
+    gid_t gid;
+    char user[256];		/*!< empty if not looked up yet */
+    char group[256];
+    unsigned char * buf;	/*!< file read buffer */
+};
+
+/**
+ * Free a per worker cache.
+ */
+void fileVerifyCacheFree(struct fileVerifyCache_s * cache);
+
+/**
+ * Copy the expected state of the current file of an rpmfi.
+ * @param fv		file to fill in
+ * @param fi		file info set (current file)
+ * @param rootDir	root directory (or NULL)
+ * @param flags		attributes to verify (masked by the file's VFlags)
+ */
+void fileVerifyInit(struct fileVerify_s * fv, rpmfi fi, const char * rootDir,
+		rpmVerifyAttrs flags);
+
+/**
+ * Free data of a file verification.
+ */
+void fileVerifyFree(struct fileVerify_s * fv);
+
+/**
+ * Verify a file on disk, setting fv->res. Safe to call without the GIL,
+ * from multiple threads (each with its own cache).
+ * @param fv		file to verify
+ * @param cache		name lookup cache of the calling thread
+ */
+void fileVerify(struct fileVerify_s * fv, struct fileVerifyCache_s * cache);
+
+#endif
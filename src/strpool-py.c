@@ -0,0 +1,134 @@
+/** \ingroup py_c
+ * \file python/strpool-py.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <rpm/rpmstring.h>
+
+#include "strpool-py.h"
+
+/**
+ * Strings live back to back (nul terminated) in one buffer, ids are found
+ * through an open addressing hash table of buffer offsets.
+ */
+struct strpool_s {
+    char * data;		/*!< string buffer */
+    size_t datalen;
+    size_t dataalloced;
+    size_t * offs;		/*!< string offsets, indexed by id */
+    unsigned int n;		/*!< no. of strings */
+    unsigned int nalloced;
+    unsigned int * slots;	/*!< hash table of ids, 0 is empty */
+    unsigned int nslots;	/*!< always a power of 2 */
+};
+
+static unsigned int strHash(const char * s, int len)
+{
+    unsigned int h = 5381;
+    int i;
+
+    for (i = 0; i < len; i++)
+	h = (h << 5) + h + (unsigned char) s[i];
+    return h;
+}
+
+static void strpoolRehash(strpool pool, unsigned int nslots)
+{
+    unsigned int id;
+
+    free(pool->slots);
+    pool->nslots = nslots;
+    pool->slots = xcalloc(nslots, sizeof(*pool->slots));
+    for (id = 1; id <= pool->n; id++) {
+	const char * s = pool->data + pool->offs[id];
+	unsigned int i = strHash(s, strlen(s)) & (nslots - 1);
+	while (pool->slots[i])
+	    i = (i + 1) & (nslots - 1);
+	pool->slots[i] = id;
+    }
+}
+
+strpool strpoolNew(void)
+{
+    strpool pool = xcalloc(1, sizeof(*pool));
+
+    pool->dataalloced = 4096;
+    pool->data = xmalloc(pool->dataalloced);
+    pool->nalloced = 256;
+    pool->offs = xmalloc(pool->nalloced * sizeof(*pool->offs));
+    strpoolRehash(pool, 512);
+    return pool;
+}
+
+strpool strpoolFree(strpool pool)
+{
+    if (pool) {
+	free(pool->data);
+	free(pool->offs);
+	free(pool->slots);
+	free(pool);
+    }
+    return NULL;
+}
+
+unsigned int strpoolIdn(strpool pool, const char * s, int len, int create)
+{
+    unsigned int mask = pool->nslots - 1;
+    unsigned int i, id;
+
+    if (len < 0)
+	len = strlen(s);
+
+    for (i = strHash(s, len) & mask; (id = pool->slots[i]) != 0;
+	 i = (i + 1) & mask) {
+	const char * t = pool->data + pool->offs[id];
+	if (!strncmp(t, s, len) && t[len] == '\0')
+	    return id;
+    }
+    if (!create)
+	return 0;
+
+    /* keep the table at most half full */
+    if (2 * (pool->n + 1) > pool->nslots) {
+	strpoolRehash(pool, 2 * pool->nslots);
+	mask = pool->nslots - 1;
+	for (i = strHash(s, len) & mask; pool->slots[i]; i = (i + 1) & mask)
+	    continue;
+    }
+
+    if (pool->n + 1 >= pool->nalloced) {
+	pool->nalloced *= 2;
+	pool->offs = xrealloc(pool->offs, pool->nalloced * sizeof(*pool->offs));
+    }
+    while (pool->datalen + len + 1 > pool->dataalloced) {
+	pool->dataalloced *= 2;
+	pool->data = xrealloc(pool->data, pool->dataalloced);
+    }
+
+    id = ++pool->n;
+    pool->offs[id] = pool->datalen;
+    memcpy(pool->data + pool->datalen, s, len);
+    pool->data[pool->datalen + len] = '\0';
+    pool->datalen += len + 1;
+    pool->slots[i] = id;
+    return id;
+}
+
+unsigned int strpoolId(strpool pool, const char * s, int create)
+{
+    return strpoolIdn(pool, s, -1, create);
+}
+
+const char * strpoolStr(strpool pool, unsigned int id)
+{
+    if (id == 0 || id > pool->n)
+	return NULL;
+    return pool->data + pool->offs[id];
+}
+
+unsigned int strpoolCount(strpool pool)
+{
+    return pool->n;
+}
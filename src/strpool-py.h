@@ -0,0 +1,54 @@
+#ifndef H_STRPOOL_PY
+#define H_STRPOOL_PY
+
+/** \ingroup py_c
+ * \file python/strpool-py.h
+ */
+
+/**
+ * A pool of interned strings. Every distinct string is stored once and
+ * identified by a small integer id (1 .. strpoolCount()), 0 is never used.
+ */
+typedef struct strpool_s * strpool;
+
+/**
+ * Create an empty string pool.
+ */
+strpool strpoolNew(void);
+
+/**
+ * Free a string pool.
+ * @return		NULL always
+ */
+strpool strpoolFree(strpool pool);
+
+/**
+ * Return id of a string, optionally adding it to the pool.
+ * @param pool		string pool
+ * @param s		string
+ * @param len		string length (-1 for strlen())
+ * @param create	add the string if not yet in the pool?
+ * @return		string id, 0 if not found
+ */
+unsigned int strpoolIdn(strpool pool, const char * s, int len, int create);
+
+/**
+ * Return id of a string, optionally adding it to the pool.
+ */
+unsigned int strpoolId(strpool pool, const char * s, int create);
+
+/**
+ * Return string of an id. The pointer is valid until the next string
+ * is added to the pool.
+ * @param pool		string pool
+ * @param id		string id
+ * @return		string, NULL on invalid id
+ */
+const char * strpoolStr(strpool pool, unsigned int id);
+
+/**
+ * Return no. of strings in a pool.
+ */
+unsigned int strpoolCount(strpool pool);
+
+#endif